@@ -20,977 +20,252 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#include <cassert>
-#include <exception>
-#include <memory>
-#include <stdexcept>
-#include <type_traits>
-#include <utility>
-#include <variant>
+#include "Future.h"
 
-/*
- * With or without synchronization?
- */
-#define YOLO_SINGLE_THREADED
-
-#if defined(YOLO_SINGLE_THREADED)
-#define YOLO_NOEXCEPT noexcept
-#else
-#define YOLO_NOEXCEPT
-#endif
-
-#if !defined(YOLO_SINGLE_THREADED)
-#include <mutex>
+#if defined(__linux__)
+#include <ctime>
 #endif
 
 namespace yolo
 {
-  template <typename T>
-  class future;
-
-  namespace detail
-  {
-    template <typename T>
-    struct is_future : std::false_type
-    {
-    };
-
-    template <typename T>
-    struct is_future<future<T>> : std::true_type
-    {
-    };
-
-    template <typename T>
-    inline constexpr bool is_future_v = is_future<T>::value;
-
-    template <typename T>
-    struct future_unwrap
-    {
-      using type = T;
-    };
-
-    template <typename T>
-    struct future_unwrap<future<T>>
-    {
-      using type = T;
-    };
-
-    template <typename T>
-    using future_unwrap_t = typename future_unwrap<T>::type;
-
-  } // namespace detail
-
-  class future_error : public std::logic_error
-  {
-  public:
-    explicit future_error(const char* str)
-      : std::logic_error(str)
-    {
-    }
-  };
-
   namespace detail
   {
-    struct future_helper;
-
-    /*
-     * Maybe put the implementation into a cpp file to generate less code
-     */
-    [[noreturn]] void throw_future_error(const char* what)
+    void throw_future_error(const char* what)
     {
       throw future_error(what);
     }
 
-    /*
-     * Maybe put the implementation into a cpp file to generate less code
-     */
-    [[nodiscard]] std::exception_ptr make_future_error(const char* what)
+    std::exception_ptr make_future_error(const char* what)
     {
       return std::make_exception_ptr(future_error(what));
     }
 
-    struct future_void
-    {
-    };
-
-    template <typename T>
-    using future_storage_t = std::conditional_t<std::is_void_v<T>, future_void, T>;
-    template <typename T>
-    using future_value = std::variant<std::monostate, future_storage_t<T>, std::exception_ptr>;
-
-    template <typename T>
-    struct is_valid_future_value
-      : std::negation<std::disjunction<std::is_same<T, std::monostate>, std::is_same<T, std::exception_ptr>>>
-    {
-    };
-
-    template <typename T>
-    inline constexpr bool is_valid_future_value_v = is_valid_future_value<T>::value;
-
-    template <typename T>
-    struct is_valid_future_result
-      : std::negation<
-          std::disjunction<std::is_convertible<T, std::monostate>, std::is_convertible<T, std::exception_ptr>>>
-    {
-    };
-
-    template <typename T>
-    inline constexpr bool is_valid_future_result_v = is_valid_future_result<T>::value;
-
-    struct future_state_base
-    {
-    };
-
-    struct future_continuation;
-
-    using future_next_ptr = std::unique_ptr<future_continuation>;
-    using future_next = std::pair<future_next_ptr, std::shared_ptr<future_state_base>>;
-
-    struct future_continuation
-    {
-      future_continuation() = default;
-      virtual ~future_continuation() = default;
-
-      future_continuation(const future_continuation& that) = delete;
-      future_continuation& operator=(const future_continuation& that) = delete;
-
-      [[nodiscard]] virtual future_next continue_with(future_state_base& state) = 0;
-    };
-
     void execute_future(future_next next)
     {
       while (next.first)
         next = next.first->continue_with(*next.second);
     }
 
-    template <typename T>
-    struct future_state : public future_state_base
+#if defined(YOLO_FUTURE_REGISTRY)
+    /*
+     * Records of one thread ordered by age. Only the owning thread appends, other threads merely take the
+     * lock to remove states they destroy or to dump the list, so it is uncontended in the common case.
+     */
+    struct future_registry_list
     {
-      future_state() = default;
-
-      future_state(const future_state& that) = delete;
-      future_state& operator=(const future_state& that) = delete;
-
-      [[nodiscard]] bool ready() const YOLO_NOEXCEPT
-      {
 #if !defined(YOLO_SINGLE_THREADED)
-        const std::lock_guard lock(_mutex);
+      std::mutex _mutex;
 #endif
 
-        return ready_impl();
-      }
+      future_record _head;
+      bool _owned = true;
 
-      [[nodiscard]] future_next_ptr next() noexcept
+      future_registry_list()
       {
-#if !defined(YOLO_SINGLE_THREADED)
-        const std::lock_guard lock(_mutex);
-#endif
-
-        assert(ready_impl());
-
-        return std::move(_continuation);
+        _head._prev = _head._next = &_head;
       }
+    };
 
-      [[nodiscard]] future_next_ptr chain(future_next_ptr&& cont) noexcept
+    namespace
+    {
+      struct future_registry
       {
 #if !defined(YOLO_SINGLE_THREADED)
-        const std::lock_guard lock(_mutex);
+        std::mutex _mutex;
 #endif
 
-        assert(!_continuation);
+        std::vector<std::unique_ptr<future_registry_list>> _lists;
+      };
 
-        if (ready_impl())
-          return std::move(cont);
-
-        _continuation = std::move(cont);
-
-        return nullptr;
-      }
-
-      template <typename Arg>
-      void set_value(Arg&& value)
+      future_registry& registry()
       {
-#if !defined(YOLO_SINGLE_THREADED)
-        const std::lock_guard lock(_mutex);
-#endif
+        // Never destroyed, states may outlive static destruction
+        static future_registry* const instance = new future_registry();
 
-        _value = std::forward<Arg>(value);
+        return *instance;
       }
 
-      template <typename Arg>
-      void set_value_unsafe(Arg&& value)
+      /*
+       * Takes over the list of a thread which exited or adds a new one
+       */
+      future_registry_list& acquire_registry_list()
       {
-        _value = std::forward<Arg>(value);
-      }
-
-      [[nodiscard]] future_value<T>&& move_value() noexcept
-      {
-        return std::move(_value);
-      }
+        future_registry& reg = registry();
 
-    private:
 #if !defined(YOLO_SINGLE_THREADED)
-      mutable std::mutex _mutex;
+        const std::lock_guard lock(reg._mutex);
 #endif
 
-      future_value<T> _value;
-      future_next_ptr _continuation;
-
-      [[nodiscard]] bool ready_impl() const noexcept
-      {
-        return (_value.index() != 0);
-      }
-    };
-
-    template <typename T, typename U>
-    struct future_attach : future_continuation
-    {
-      explicit future_attach(std::shared_ptr<future_state<U>>&& dest)
-        : future_continuation{}
-        , _dest(std::move(dest))
-      {
-      }
-
-      [[nodiscard]] future_next continue_with(future_state_base& state) override
-      {
-        _dest->set_value(static_cast<future_state<T>&>(state).move_value());
-
-        future_next_ptr next = _dest->next();
-
-        return {std::move(next), std::move(_dest)};
-      }
-
-    private:
-      std::shared_ptr<future_state<U>> _dest;
-    };
-
-    template <typename T, typename U>
-    [[nodiscard]] future_next attach_future(
-      std::shared_ptr<future_state<T>>&& src,
-      std::shared_ptr<future_state<U>>&& dest)
-    {
-      if (src)
-      {
-        if (!src->ready())
-        {
-          future_next_ptr next = src->chain(std::make_unique<future_attach<T, U>>(std::move(dest)));
-
-          return {std::move(next), std::move(src)};
-        }
-
-        dest->set_value(src->move_value());
-      }
-      else
-        dest->set_value(make_future_error("invalid future"));
-
-      future_next_ptr next = dest->next();
-
-      return {std::move(next), std::move(dest)};
-    }
-
-    template <typename T, typename U, typename Func>
-    void invoke_future_then(future_state<T>& dest, future_value<U>&& src, Func&& func)
-    {
-      if constexpr (std::is_void_v<T>)
-      {
-        if constexpr (std::is_void_v<U>)
-          std::invoke(std::forward<Func>(func));
-        else
-          std::invoke(std::forward<Func>(func), std::get<U>(std::move(src)));
-
-        dest.set_value(future_void{});
-      }
-      else
-      {
-        if constexpr (std::is_void_v<U>)
-          dest.set_value(std::invoke(std::forward<Func>(func)));
-        else
-          dest.set_value(std::invoke(std::forward<Func>(func), std::get<U>(std::move(src))));
-      }
-    }
-
-    template <typename T, typename Func>
-    struct future_invoke_result
-    {
-      using type = std::decay_t<std::invoke_result_t<Func, T>>;
-    };
-
-    template <typename Func>
-    struct future_invoke_result<void, Func>
-    {
-      using type = std::decay_t<std::invoke_result_t<Func>>;
-    };
-
-    template <typename T, typename Func>
-    using future_invoke_result_t = typename future_invoke_result<T, Func>::type;
-
-    template <typename T, typename Func>
-    using future_then_result_t = future_unwrap_t<future_invoke_result_t<T, Func>>;
-
-    template <typename T, typename Func>
-    struct future_then : future_continuation
-    {
-      using result_type = future_then_result_t<T, Func>;
-
-      static_assert(
-        detail::is_valid_future_result_v<result_type>,
-        "T must not be convertible to any of the types used internally.");
-
-      template <typename Arg>
-      future_then(Arg&& func, std::shared_ptr<future_state<result_type>> state)
-        : future_continuation{}
-        , _func(std::forward<Arg>(func))
-        , _state(std::move(state))
-      {
-      }
-
-      [[nodiscard]] future_next continue_with(future_state_base& state) override
-      {
-        future_value<T>&& value = static_cast<future_state<T>&>(state).move_value();
-
-        if (value.index() == 1)
+        for (const auto& list : reg._lists)
         {
-          try
+          if (!list->_owned)
           {
-            if constexpr (is_future_v<future_invoke_result_t<T, Func>>)
-            {
-              auto fut = std::invoke(std::move(_func), std::get<T>(std::move(value)));
-
-              return attach_future(std::move(fut._state), std::move(_state));
-            }
-            else
-            {
-              invoke_future_then<result_type, T>(*_state, std::move(value), std::move(_func));
-            }
-          }
-          catch (...)
-          {
-            _state->set_value(std::current_exception());
+            list->_owned = true;
+
+            return *list;
           }
         }
-        else
-        {
-          _state->set_value(std::get<std::exception_ptr>(std::move(value)));
-        }
-
-        future_next_ptr next = _state->next();
 
-        return {std::move(next), std::move(_state)};
+        return *reg._lists.emplace_back(std::make_unique<future_registry_list>());
       }
 
-    private:
-      Func _func;
-      std::shared_ptr<future_state<result_type>> _state;
-    };
-
-    template <typename T, typename Func>
-    void invoke_future_catch(future_state<T>& dest, std::exception_ptr&& ex, Func&& func)
-    {
-      if constexpr (std::is_void_v<T>)
-      {
-        std::invoke(std::forward<Func>(func), std::move(ex));
-
-        dest.set_value(future_void{});
-      }
-      else
+      struct future_registry_owner
       {
-        dest.set_value(std::invoke(std::forward<Func>(func), std::move(ex)));
-      }
-    }
-
-    template <typename Func>
-    using future_catch_invoke_result_t = std::decay_t<std::invoke_result_t<Func, std::exception_ptr>>;
-
-    template <typename T, typename Func>
-    using future_catch_result_t = std::common_type_t<T, future_unwrap_t<future_catch_invoke_result_t<Func>>>;
-
-    template <typename T, typename Func>
-    struct future_catch : future_continuation
-    {
-      using result_type = future_catch_result_t<T, Func>;
-
-      static_assert(
-        std::disjunction_v<std::is_void<result_type>, std::is_convertible<T, result_type>>,
-        "The result of the continuation function is not convertible to the future result type.");
+        future_registry_list& _list = acquire_registry_list();
 
-      static_assert(
-        detail::is_valid_future_result_v<result_type>,
-        "T must not be convertible to any of the types used internally.");
-
-      template <typename Arg>
-      future_catch(Arg&& func, std::shared_ptr<future_state<result_type>> state)
-        : future_continuation{}
-        , _func(std::forward<Arg>(func))
-        , _state(std::move(state))
-      {
-      }
-
-      [[nodiscard]] future_next continue_with(future_state_base& state) override
-      {
-        future_value<T>&& value = static_cast<future_state<T>&>(state).move_value();
-
-        if (value.index() == 1)
+        ~future_registry_owner()
         {
-          _state->set_value(std::move(value));
-        }
-        else
-        {
-          try
-          {
-            if constexpr (is_future_v<future_catch_invoke_result_t<Func>>)
-            {
-              auto fut = std::invoke(std::move(_func), std::get<std::exception_ptr>(std::move(value)));
-
-              return attach_future(std::move(fut._state), std::move(_state));
-            }
-            else
-            {
-              invoke_future_catch<result_type>(
-                *_state, std::get<std::exception_ptr>(std::move(value)), std::move(_func));
-            }
-          }
-          catch (...)
-          {
-            _state->set_value(std::current_exception());
-          }
+#if !defined(YOLO_SINGLE_THREADED)
+          const std::lock_guard lock(registry()._mutex);
+#endif
+
+          _list._owned = false;
         }
+      };
 
-        future_next_ptr next = _state->next();
+      thread_local future_registry_owner registry_owner;
 
-        return {std::move(next), std::move(_state)};
+      [[nodiscard]] std::chrono::steady_clock::time_point registry_now() noexcept
+      {
+#if defined(__linux__)
+        // Ages are only of interest in milliseconds, the coarse clock is several times cheaper to read
+        timespec now{};
+        ::clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+        return std::chrono::steady_clock::time_point(
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec)));
+#else
+        return std::chrono::steady_clock::now();
+#endif
       }
 
-    private:
-      Func _func;
-      std::shared_ptr<future_state<result_type>> _state;
-    };
-
-  } // namespace detail
-
-  template <typename T>
-  class future
-  {
-    friend detail::future_helper;
-
-    static_assert(detail::is_valid_future_value_v<T>, "T must not be any of the types used internally.");
-
-  public:
-    future() = default;
-    future(const future& that) = delete;
-    future(future&& that) = default;
+    } // namespace
 
-    future& operator=(const future& that) = delete;
-    future& operator=(future&& that) = default;
-
-    [[nodiscard]] bool valid() const noexcept
-    {
-      return (_state != nullptr);
-    }
-
-    [[nodiscard]] bool ready() const YOLO_NOEXCEPT
-    {
-      return _state && _state->ready();
-    }
-
-    template <typename Func>
-    future<detail::future_then_result_t<T, std::decay_t<Func>>> then(Func&& func)
+    future_state_base::future_state_base(future_origin origin)
     {
-      using result_type = detail::future_then_result_t<T, std::decay_t<Func>>;
-      using continuation_type = detail::future_then<T, std::decay_t<Func>>;
-
-      check();
-
-      future<result_type> fut;
-      fut._state = std::make_shared<detail::future_state<result_type>>();
+      future_registry_list& list = registry_owner._list;
 
-      detail::future_next_ptr next =
-        _state->chain(std::make_unique<continuation_type>(std::forward<Func>(func), fut._state));
+      _record._list = &list;
+      _record._created = registry_now();
+      _record._origin = origin;
 
-      detail::execute_future({std::move(next), std::move(_state)});
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(list._mutex);
+#endif
 
-      return fut;
+      _record._prev = list._head._prev;
+      _record._next = &list._head;
+      _record._prev->_next = _record._next->_prev = &_record;
     }
 
-    template <typename Func>
-    future<detail::future_catch_result_t<T, std::decay_t<Func>>> catch_exception(Func&& func)
+    future_state_base::~future_state_base()
     {
-      using result_type = detail::future_catch_result_t<T, std::decay_t<Func>>;
-      using continuation_type = detail::future_catch<T, std::decay_t<Func>>;
-
-      check();
-
-      future<result_type> fut;
-      fut._state = std::make_shared<detail::future_state<result_type>>();
-
-      detail::future_next_ptr next =
-        _state->chain(std::make_unique<continuation_type>(std::forward<Func>(func), fut._state));
-
-      detail::execute_future({std::move(next), std::move(_state)});
-
-      return fut;
-    }
-
-  private:
-    template <typename U>
-    friend class future;
-    template <typename U, typename Func>
-    friend struct detail::future_then;
-    template <typename U, typename Func>
-    friend struct detail::future_catch;
-
-    std::shared_ptr<detail::future_state<T>> _state;
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_record._list->_mutex);
+#endif
 
-    void check() const
-    {
-      if (!_state)
-        detail::throw_future_error("invalid future");
+      _record._prev->_next = _record._next;
+      _record._next->_prev = _record._prev;
     }
-  };
-
-  namespace detail
-  {
-    template <typename T>
-    struct promise_base
-    {
-      std::shared_ptr<detail::future_state<T>> _state;
-
-      promise_base() = default;
-      promise_base(const promise_base& that) = delete;
-      promise_base(promise_base&& that) = default;
-
-      promise_base& operator=(const promise_base& that) = delete;
-      promise_base& operator=(promise_base&& that) = default;
-
-      ~promise_base()
-      {
-        if (_state)
-          satisfy(make_future_error("broken promise"));
-      }
-
-      void check() const
-      {
-        if (!_state)
-          throw_future_error("promise already satisfied");
-      }
-
-      template <typename Arg>
-      void satisfy(Arg&& arg)
-      {
-        _state->set_value(std::forward<Arg>(arg));
-
-        future_next_ptr next = _state->next();
-
-        execute_future({std::move(next), std::move(_state)});
-      }
-    };
+#endif
 
   } // namespace detail
 
-  template <typename T>
-  class promise : private detail::promise_base<T>
-  {
-    friend detail::future_helper;
-
-    static_assert(detail::is_valid_future_value_v<T>, "T must not be any of the types used internally.");
-
-  public:
-    promise() = default;
-    promise(const promise& that) = delete;
-    promise(promise&& that) = default;
-
-    promise& operator=(const promise& that) = delete;
-    promise& operator=(promise&& that) = default;
-
-    void set_value(const T& value)
-    {
-      this->check();
-      this->satisfy(value);
-    }
-
-    void set_value(T&& value)
-    {
-      this->check();
-      this->satisfy(std::move(value));
-    }
-
-    void set_exception(const std::exception_ptr& ex)
-    {
-      this->check();
-      this->satisfy(ex);
-    }
-
-    void set_exception(std::exception_ptr&& ex)
-    {
-      this->check();
-      this->satisfy(std::move(ex));
-    }
-  };
-
-  template <>
-  class promise<void> : private detail::promise_base<void>
+#if defined(YOLO_FUTURE_REGISTRY)
+  std::vector<future_info> oldest_pending_futures(std::size_t count)
   {
-    friend detail::future_helper;
-
-  public:
-    promise() = default;
-    promise(const promise& that) = delete;
-    promise(promise&& that) = default;
+    const auto now = detail::registry_now();
 
-    promise& operator=(const promise& that) = delete;
-    promise& operator=(promise&& that) = default;
+    std::vector<future_info> result;
+    detail::future_registry& reg = detail::registry();
 
-    void set_value()
-    {
-      this->check();
-      this->satisfy(detail::future_void{});
-    }
+#if !defined(YOLO_SINGLE_THREADED)
+    const std::lock_guard registry_lock(reg._mutex);
+#endif
 
-    void set_exception(const std::exception_ptr& ex)
+    for (const auto& list : reg._lists)
     {
-      this->check();
-      this->satisfy(ex);
-    }
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard list_lock(list->_mutex);
+#endif
 
-    void set_exception(std::exception_ptr&& ex)
-    {
-      this->check();
-      this->satisfy(std::move(ex));
-    }
-  };
+      // Every list is ordered by age, so no more than count states of each list can make it
+      std::size_t taken = 0;
 
-  namespace detail
-  {
-    struct future_helper
-    {
-      template <typename T>
-      static std::pair<promise<T>, future<T>> make()
+      for (detail::future_record* record = list->_head._next; (record != &list->_head) && (taken < count);
+           record = record->_next)
       {
-        promise<T> prm;
-        future<T> fut;
-
-        prm._state = fut._state = std::make_shared<future_state<T>>();
+#if defined(YOLO_SINGLE_THREADED)
+        const bool ready = record->_ready;
+#else
+        const bool ready = record->_ready.load(std::memory_order_relaxed);
+#endif
 
-        return {std::move(prm), std::move(fut)};
-      }
+        if (ready)
+          continue;
 
-      template <typename T, typename Arg>
-      static future<T> make_ready(Arg&& arg)
-      {
-        future<T> fut;
+        future_info info;
+        info.file = record->_origin._site._file;
+        info.line = record->_origin._site._line;
+        info.depth = record->_origin._depth;
+        info.age = now - record->_created;
 
-        fut._state = std::make_shared<future_state<T>>();
-        fut._state->set_value_unsafe(std::forward<Arg>(arg));
+        result.push_back(info);
 
-        return fut;
+        ++taken;
       }
-    };
-
-  } // namespace detail
-
-  template <typename T>
-  [[nodiscard]] std::pair<promise<T>, future<T>> make_promise()
-  {
-    return detail::future_helper::make<T>();
-  }
-
-  template <typename T>
-  [[nodiscard]] future<std::decay_t<T>> make_ready_future(T&& value)
-  {
-    return detail::future_helper::make_ready<std::decay_t<T>>(std::forward<T>(value));
-  }
-
-  template <typename T, typename Arg>
-  [[nodiscard]] future<T> make_ready_future(Arg&& value)
-  {
-    return detail::future_helper::make_ready<T>(std::forward<Arg>(value));
-  }
-
-  template <typename T>
-  [[nodiscard]] future<T> make_exceptional_future(const std::exception_ptr& ex)
-  {
-    return detail::future_helper::make_ready<T>(ex);
-  }
-
-  template <typename T>
-  [[nodiscard]] future<T> make_exceptional_future(std::exception_ptr&& ex)
-  {
-    return detail::future_helper::make_ready<T>(std::move(ex));
-  }
-
-} // namespace yolo
-
-int main()
-{
-  using namespace yolo;
-
-  struct test_exception
-  {
-  };
-
-  const auto throw_exception = []() -> long { throw test_exception{}; };
-
-  const auto exception_to_five = [](std::exception_ptr ex) {
-    try
-    {
-      std::rethrow_exception(std::move(ex));
-    }
-    catch (const test_exception&)
-    {
-      return 5;
-    }
-    catch (...)
-    {
-      return -1;
     }
-  };
-
-  // Combinations of int and void
-  {
-    auto [prm, fut] = make_promise<int>();
-
-    assert(fut.valid() && !fut.ready());
-
-    prm.set_value(5);
-
-    assert(fut.valid() && fut.ready());
-
-    int result = -1;
-    fut.then([&result](int i) { result = i; });
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<int>();
-
-    assert(!fut.ready());
-
-    int result = -1;
-    fut.then([&result](int i) { result = i; });
-
-    assert(!fut.valid() && (result == -1));
-
-    prm.set_value(5);
-
-    assert(result == 5);
-  }
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    assert(fut.valid() && !fut.ready());
-
-    prm.set_value();
-
-    assert(fut.valid() && fut.ready());
-
-    int result = -1;
-    fut.then([&result]() { result = 5; });
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    assert(fut.valid() && !fut.ready());
-
-    prm.set_value();
-
-    assert(fut.valid() && fut.ready());
-
-    int result = -1;
-    fut.then([]() { return 5; }).then([&result](int i) { result = i; });
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    int result = -1;
-    fut.then([]() { return 5; }).then([](int i) { return 2 * i; }).then([&result](int i) { result = i; });
-
-    assert(!fut.valid() && (result == -1));
-
-    prm.set_value();
-
-    assert(result == 10);
-  }
-
-  // Error propagation
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    assert(fut.valid() && !fut.ready());
-
-    int result = 5;
-    fut.then([&result]() { result = -1; });
-
-    prm.set_exception(std::make_exception_ptr(test_exception{}));
 
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    assert(fut.valid() && !fut.ready());
-
-    prm.set_exception(std::make_exception_ptr(test_exception{}));
-
-    int result = 5;
-    fut.then([&result]() { result = -1; });
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<long>();
-
-    assert(fut.valid() && !fut.ready());
-
-    long result = -1;
-    fut.catch_exception(exception_to_five).then([&result](long l) { result = l; });
-
-    prm.set_exception(std::make_exception_ptr(test_exception{}));
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<long>();
-
-    assert(fut.valid() && !fut.ready());
-
-    long result = -1;
-    fut.catch_exception(exception_to_five).then([&result](long l) { result = l; });
-
-    prm.set_value(10);
-
-    assert(!fut.valid() && (result == 10));
-  }
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    assert(fut.valid() && !fut.ready());
-
-    int result = -1;
-    fut.catch_exception([=](std::exception_ptr) {}).then([&result]() { result = 5; });
-
-    prm.set_exception(std::make_exception_ptr(test_exception{}));
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    auto [prm, fut] = make_promise<void>();
-
-    bool called = false;
-    const auto skipped = [&called](long l) {
-      called = true;
-      return l;
-    };
-
-    int result = -1;
-    fut.then(throw_exception).then(skipped).catch_exception(exception_to_five).then([&result](long l) { result = l; });
-
-    prm.set_value();
-
-    assert(!fut.valid() && !called && (result == 5));
-  }
-
-  // Inner future
-  {
-    auto [prm0, fut0] = make_promise<int>();
-    auto [prm1, fut1] = make_promise<std::unique_ptr<int>>();
-
-    future<std::unique_ptr<long>> fut2 = fut0.then([fut = std::move(fut1)](int i) mutable {
-      return fut.then([i](std::unique_ptr<int> pi) { return std::make_unique<long>(i * (pi ? *pi : 0)); });
+    std::stable_sort(result.begin(), result.end(), [](const future_info& lhs, const future_info& rhs) {
+      return lhs.age > rhs.age;
     });
 
-    long result = -1;
-    fut2.then([&result](std::unique_ptr<long> l) { result = l ? *l : -1; });
-
-    assert(!fut0.valid() && !fut1.valid() && !fut2.valid() && (result == -1));
-
-    prm0.set_value(5);
-
-    assert(result == -1);
+    if (result.size() > count)
+      result.resize(count);
 
-    prm1.set_value(std::make_unique<int>(3));
-
-    assert(result == 15);
+    return result;
   }
-  {
-    auto [prm0, fut0] = make_promise<int>();
-    auto [prm1, fut1] = make_promise<std::unique_ptr<int>>();
-
-    future<std::unique_ptr<long>> fut2 = fut0.then([fut = std::move(fut1)](int i) mutable {
-      return fut.then([i](std::unique_ptr<int> pi) { return std::make_unique<long>(i * (pi ? *pi : 0)); });
-    });
-
-    long result = -1;
-    fut2.then([&result](std::unique_ptr<long> l) { result = l ? *l : -1; });
-
-    assert(!fut0.valid() && !fut1.valid() && !fut2.valid() && (result == -1));
 
-    prm1.set_value(std::make_unique<int>(3));
-
-    assert(result == -1);
-
-    prm0.set_value(5);
-
-    assert(result == 15);
-  }
+  void dump_pending_futures(std::FILE* out, std::size_t count)
   {
-    auto [prm0, fut0] = make_promise<std::unique_ptr<long>>();
-    auto [prm1, fut1] = make_promise<std::unique_ptr<int>>();
-
-    future<std::unique_ptr<long>> fut2 =
-      fut0.catch_exception([=, fut = std::move(fut1)](std::exception_ptr ex) mutable {
-        return fut.then([i = exception_to_five(std::move(ex))](std::unique_ptr<int> pi) {
-          return std::make_unique<long>(i * (pi ? *pi : 0));
-        });
-      });
-
-    long result = -1;
-    fut2.then([&result](std::unique_ptr<long> l) { result = l ? *l : -1; });
-
-    assert(!fut0.valid() && !fut1.valid() && !fut2.valid() && (result == -1));
-
-    prm0.set_exception(std::make_exception_ptr(test_exception{}));
-
-    assert(result == -1);
-
-    prm1.set_value(std::make_unique<int>(3));
-
-    assert(result == 15);
-  }
-
-  // Ready future
-  {
-    future<int> fut = make_ready_future(5);
-
-    assert(fut.ready());
-
-    int result = -1;
-    fut.then([&result](int i) { result = i; });
-
-    assert(!fut.valid() && (result == 5));
-  }
-  {
-    future<long> fut = make_ready_future<long>(5);
-
-    assert(fut.ready());
-
-    long result = -1;
-    fut.then([&result](long l) { result = l; });
-
-    assert(!fut.valid() && (result == 5));
+    for (const future_info& info : oldest_pending_futures(count))
+    {
+      std::fprintf(
+        out,
+        "%s:%u depth %zu age %lldms\n",
+        info.file ? info.file : "<unknown>",
+        info.line,
+        info.depth,
+        static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(info.age).count()));
+    }
   }
-  {
-    future<int> fut = make_exceptional_future<int>(std::make_exception_ptr(test_exception{}));
-
-    assert(fut.ready());
-
-    long result = -1;
-    fut.catch_exception(exception_to_five).then([&result](int i) { result = i; });
+#endif
 
-    assert(!fut.valid() && (result == 5));
-  }
+  template struct detail::future_state<void>;
+  template struct detail::future_state<int>;
+  template struct detail::future_state<bool>;
+  template struct detail::future_state<std::string>;
+
+  template struct detail::promise_base<void>;
+  template struct detail::promise_base<int>;
+  template struct detail::promise_base<bool>;
+  template struct detail::promise_base<std::string>;
+
+  template class future<void>;
+  template class future<int>;
+  template class future<bool>;
+  template class future<std::string>;
+
+  template class promise<int>;
+  template class promise<bool>;
+  template class promise<std::string>;
+
+#if !defined(YOLO_FUTURE_REGISTRY)
+  template std::pair<promise<void>, future<void>> make_promise<void>();
+  template std::pair<promise<int>, future<int>> make_promise<int>();
+  template std::pair<promise<bool>, future<bool>> make_promise<bool>();
+  template std::pair<promise<std::string>, future<std::string>> make_promise<std::string>();
+#endif
 
-  return 0;
-}
+} // namespace yolo
@@ -0,0 +1,1064 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_H
+#define YOLO_FUTURE_H
+
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+/*
+ * With or without synchronization? Define YOLO_MULTI_THREADED for the latter.
+ * Has to match the setting the yolo library was compiled with.
+ */
+#if !defined(YOLO_MULTI_THREADED)
+#define YOLO_SINGLE_THREADED
+#endif
+
+#if defined(YOLO_SINGLE_THREADED)
+#define YOLO_NOEXCEPT noexcept
+#else
+#define YOLO_NOEXCEPT
+#endif
+
+/*
+ * Give every future state its own cache lines? Costs memory, avoids false sharing between threads.
+ * Has to match the setting the yolo library was compiled with.
+ */
+// #define YOLO_CACHE_ALIGNED
+
+#if !defined(YOLO_CACHE_LINE_SIZE)
+#define YOLO_CACHE_LINE_SIZE 64
+#endif
+
+#if defined(YOLO_CACHE_ALIGNED)
+#define YOLO_CACHE_ALIGN alignas(YOLO_CACHE_LINE_SIZE)
+#else
+#define YOLO_CACHE_ALIGN
+#endif
+
+/*
+ * Track all live future states for diagnostics with oldest_pending_futures()?
+ * Has to match the setting the yolo library was compiled with.
+ */
+// #define YOLO_FUTURE_REGISTRY
+
+#if !defined(YOLO_SINGLE_THREADED)
+#include <atomic>
+#include <mutex>
+#endif
+
+#if defined(YOLO_FUTURE_REGISTRY)
+#include <cstdio>
+#include <vector>
+#endif
+
+namespace yolo
+{
+  template <typename T>
+  class future;
+
+  namespace detail
+  {
+    template <typename T>
+    struct is_future : std::false_type
+    {
+    };
+
+    template <typename T>
+    struct is_future<future<T>> : std::true_type
+    {
+    };
+
+    template <typename T>
+    inline constexpr bool is_future_v = is_future<T>::value;
+
+    template <typename T>
+    struct future_unwrap
+    {
+      using type = T;
+    };
+
+    template <typename T>
+    struct future_unwrap<future<T>>
+    {
+      using type = T;
+    };
+
+    template <typename T>
+    using future_unwrap_t = typename future_unwrap<T>::type;
+
+  } // namespace detail
+
+  class future_error : public std::logic_error
+  {
+  public:
+    explicit future_error(const char* str)
+      : std::logic_error(str)
+    {
+    }
+  };
+
+  /*
+   * Lanes of executors which schedule continuations by priority
+   */
+  enum class priority
+  {
+    high,
+    normal,
+    low
+  };
+
+  namespace detail
+  {
+    struct future_helper;
+
+    [[noreturn]] void throw_future_error(const char* what);
+
+    [[nodiscard]] std::exception_ptr make_future_error(const char* what);
+
+    struct future_void
+    {
+    };
+
+    template <typename T>
+    using future_storage_t = std::conditional_t<std::is_void_v<T>, future_void, T>;
+    template <typename T>
+    using future_value = std::variant<std::monostate, future_storage_t<T>, std::exception_ptr>;
+
+    template <typename T>
+    struct is_valid_future_value
+      : std::negation<std::disjunction<std::is_same<T, std::monostate>, std::is_same<T, std::exception_ptr>>>
+    {
+    };
+
+    template <typename T>
+    inline constexpr bool is_valid_future_value_v = is_valid_future_value<T>::value;
+
+    template <typename T>
+    struct is_valid_future_result
+      : std::negation<
+          std::disjunction<std::is_convertible<T, std::monostate>, std::is_convertible<T, std::exception_ptr>>>
+    {
+    };
+
+    template <typename T>
+    inline constexpr bool is_valid_future_result_v = is_valid_future_result<T>::value;
+
+#if defined(YOLO_FUTURE_REGISTRY)
+    /*
+     * Source location of the call which created a future chain
+     */
+    struct future_site
+    {
+      const char* _file = nullptr;
+      unsigned _line = 0;
+
+      [[nodiscard]] static constexpr future_site current(
+        const char* file = __builtin_FILE(), unsigned line = __builtin_LINE()) noexcept
+      {
+        return {file, line};
+      }
+    };
+#else
+    struct future_site
+    {
+      [[nodiscard]] static constexpr future_site current() noexcept
+      {
+        return {};
+      }
+    };
+#endif
+
+    /*
+     * Where a state comes from, only recorded with YOLO_FUTURE_REGISTRY
+     */
+    struct future_origin
+    {
+      future_site _site;
+#if defined(YOLO_FUTURE_REGISTRY)
+      std::size_t _depth = 0;
+#endif
+    };
+
+#if defined(YOLO_FUTURE_REGISTRY)
+    struct future_registry_list;
+
+    /*
+     * Entry of a live state in the list of the thread which created it
+     */
+    struct future_record
+    {
+      future_record* _prev = nullptr;
+      future_record* _next = nullptr;
+      future_registry_list* _list = nullptr;
+      std::chrono::steady_clock::time_point _created;
+      future_origin _origin;
+#if defined(YOLO_SINGLE_THREADED)
+      bool _ready = false;
+#else
+      std::atomic<bool> _ready{false};
+#endif
+    };
+#endif
+
+    struct future_state_base
+    {
+#if defined(YOLO_FUTURE_REGISTRY)
+      future_state_base()
+        : future_state_base(future_origin{})
+      {
+      }
+
+      /*
+       * The record is complete before it is linked, so dumping threads never see it being written
+       */
+      explicit future_state_base(future_origin origin);
+      ~future_state_base();
+
+      future_state_base(const future_state_base& that) = delete;
+      future_state_base& operator=(const future_state_base& that) = delete;
+
+      [[nodiscard]] future_origin successor() const noexcept
+      {
+        return {_record._origin._site, _record._origin._depth + 1};
+      }
+
+      void satisfied() noexcept
+      {
+#if defined(YOLO_SINGLE_THREADED)
+        _record._ready = true;
+#else
+        _record._ready.store(true, std::memory_order_relaxed);
+#endif
+      }
+
+    private:
+      future_record _record;
+#else
+      future_state_base() = default;
+
+      explicit future_state_base(future_origin) noexcept
+      {
+      }
+
+      [[nodiscard]] future_origin successor() const noexcept
+      {
+        return {};
+      }
+
+      void satisfied() noexcept
+      {
+      }
+#endif
+    };
+
+    struct future_continuation;
+
+    using future_next_ptr = std::unique_ptr<future_continuation>;
+    using future_next = std::pair<future_next_ptr, std::shared_ptr<future_state_base>>;
+
+    struct future_continuation
+    {
+      future_continuation() = default;
+      virtual ~future_continuation() = default;
+
+      future_continuation(const future_continuation& that) = delete;
+      future_continuation& operator=(const future_continuation& that) = delete;
+
+      [[nodiscard]] virtual future_next continue_with(future_state_base& state) = 0;
+    };
+
+    void execute_future(future_next next);
+
+    /*
+     * Decides which of several racing completions gets to satisfy a state
+     */
+    struct future_flag
+    {
+      [[nodiscard]] bool claim() noexcept
+      {
+#if defined(YOLO_SINGLE_THREADED)
+        return !std::exchange(_claimed, true);
+#else
+        return !_claimed.exchange(true, std::memory_order_acq_rel);
+#endif
+      }
+
+    private:
+#if defined(YOLO_SINGLE_THREADED)
+      bool _claimed = false;
+#else
+      std::atomic<bool> _claimed{false};
+#endif
+    };
+
+    /*
+     * Producer and consumer both take the lock first, so with YOLO_CACHE_ALIGNED only whole states get
+     * their own lines. Separating members within a state would merely add padding.
+     */
+    template <typename T>
+    struct YOLO_CACHE_ALIGN future_state : public future_state_base
+    {
+      future_state() = default;
+
+      explicit future_state(future_origin origin)
+        : future_state_base(origin)
+      {
+      }
+
+      future_state(const future_state& that) = delete;
+      future_state& operator=(const future_state& that) = delete;
+
+      [[nodiscard]] bool ready() const YOLO_NOEXCEPT
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        return ready_impl();
+      }
+
+      [[nodiscard]] future_next_ptr next() noexcept
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        assert(ready_impl());
+
+        return std::move(_continuation);
+      }
+
+      [[nodiscard]] future_next_ptr chain(future_next_ptr&& cont) noexcept
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        assert(!_continuation);
+
+        if (ready_impl())
+          return std::move(cont);
+
+        _continuation = std::move(cont);
+
+        return nullptr;
+      }
+
+      template <typename Arg>
+      void set_value(Arg&& value)
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        _value = std::forward<Arg>(value);
+
+        satisfied();
+      }
+
+      template <typename Arg>
+      void set_value_unsafe(Arg&& value)
+      {
+        _value = std::forward<Arg>(value);
+
+        satisfied();
+      }
+
+      [[nodiscard]] future_value<T>&& move_value() noexcept
+      {
+        return std::move(_value);
+      }
+
+    private:
+#if !defined(YOLO_SINGLE_THREADED)
+      mutable std::mutex _mutex;
+#endif
+
+      future_next_ptr _continuation;
+      future_value<T> _value;
+
+      [[nodiscard]] bool ready_impl() const noexcept
+      {
+        return (_value.index() != 0);
+      }
+    };
+
+    template <typename T, typename U>
+    struct future_attach : future_continuation
+    {
+      explicit future_attach(std::shared_ptr<future_state<U>>&& dest)
+        : future_continuation{}
+        , _dest(std::move(dest))
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        _dest->set_value(static_cast<future_state<T>&>(state).move_value());
+
+        future_next_ptr next = _dest->next();
+
+        return {std::move(next), std::move(_dest)};
+      }
+
+    private:
+      std::shared_ptr<future_state<U>> _dest;
+    };
+
+    template <typename T, typename U>
+    [[nodiscard]] future_next attach_future(
+      std::shared_ptr<future_state<T>>&& src,
+      std::shared_ptr<future_state<U>>&& dest)
+    {
+      if (src)
+      {
+        if (!src->ready())
+        {
+          future_next_ptr next = src->chain(std::make_unique<future_attach<T, U>>(std::move(dest)));
+
+          return {std::move(next), std::move(src)};
+        }
+
+        dest->set_value(src->move_value());
+      }
+      else
+        dest->set_value(make_future_error("invalid future"));
+
+      future_next_ptr next = dest->next();
+
+      return {std::move(next), std::move(dest)};
+    }
+
+    template <typename T, typename U, typename Func>
+    void invoke_future_then(future_state<T>& dest, future_value<U>&& src, Func&& func)
+    {
+      if constexpr (std::is_void_v<T>)
+      {
+        if constexpr (std::is_void_v<U>)
+          std::invoke(std::forward<Func>(func));
+        else
+          std::invoke(std::forward<Func>(func), std::get<U>(std::move(src)));
+
+        dest.set_value(future_void{});
+      }
+      else
+      {
+        if constexpr (std::is_void_v<U>)
+          dest.set_value(std::invoke(std::forward<Func>(func)));
+        else
+          dest.set_value(std::invoke(std::forward<Func>(func), std::get<U>(std::move(src))));
+      }
+    }
+
+    template <typename T, typename Func>
+    struct future_invoke_result
+    {
+      using type = std::decay_t<std::invoke_result_t<Func, T>>;
+    };
+
+    template <typename Func>
+    struct future_invoke_result<void, Func>
+    {
+      using type = std::decay_t<std::invoke_result_t<Func>>;
+    };
+
+    template <typename T, typename Func>
+    using future_invoke_result_t = typename future_invoke_result<T, Func>::type;
+
+    template <typename T, typename Func>
+    using future_then_result_t = future_unwrap_t<future_invoke_result_t<T, Func>>;
+
+    template <typename T, typename Func>
+    struct future_then : future_continuation
+    {
+      using result_type = future_then_result_t<T, Func>;
+
+      static_assert(
+        detail::is_valid_future_result_v<result_type>,
+        "T must not be convertible to any of the types used internally.");
+
+      template <typename Arg>
+      future_then(Arg&& func, std::shared_ptr<future_state<result_type>> state)
+        : future_continuation{}
+        , _func(std::forward<Arg>(func))
+        , _state(std::move(state))
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        future_value<T>&& value = static_cast<future_state<T>&>(state).move_value();
+
+        if (value.index() == 1)
+        {
+          try
+          {
+            if constexpr (is_future_v<future_invoke_result_t<T, Func>>)
+            {
+              auto fut = std::invoke(std::move(_func), std::get<T>(std::move(value)));
+
+              return attach_future(std::move(fut._state), std::move(_state));
+            }
+            else
+            {
+              invoke_future_then<result_type, T>(*_state, std::move(value), std::move(_func));
+            }
+          }
+          catch (...)
+          {
+            _state->set_value(std::current_exception());
+          }
+        }
+        else
+        {
+          _state->set_value(std::get<std::exception_ptr>(std::move(value)));
+        }
+
+        future_next_ptr next = _state->next();
+
+        return {std::move(next), std::move(_state)};
+      }
+
+    private:
+      Func _func;
+      std::shared_ptr<future_state<result_type>> _state;
+    };
+
+    template <typename T, typename Func>
+    void invoke_future_catch(future_state<T>& dest, std::exception_ptr&& ex, Func&& func)
+    {
+      if constexpr (std::is_void_v<T>)
+      {
+        std::invoke(std::forward<Func>(func), std::move(ex));
+
+        dest.set_value(future_void{});
+      }
+      else
+      {
+        dest.set_value(std::invoke(std::forward<Func>(func), std::move(ex)));
+      }
+    }
+
+    template <typename Func>
+    using future_catch_invoke_result_t = std::decay_t<std::invoke_result_t<Func, std::exception_ptr>>;
+
+    template <typename T, typename Func>
+    using future_catch_result_t = std::common_type_t<T, future_unwrap_t<future_catch_invoke_result_t<Func>>>;
+
+    template <typename T, typename Func>
+    struct future_catch : future_continuation
+    {
+      using result_type = future_catch_result_t<T, Func>;
+
+      static_assert(
+        std::disjunction_v<std::is_void<result_type>, std::is_convertible<T, result_type>>,
+        "The result of the continuation function is not convertible to the future result type.");
+
+      static_assert(
+        detail::is_valid_future_result_v<result_type>,
+        "T must not be convertible to any of the types used internally.");
+
+      template <typename Arg>
+      future_catch(Arg&& func, std::shared_ptr<future_state<result_type>> state)
+        : future_continuation{}
+        , _func(std::forward<Arg>(func))
+        , _state(std::move(state))
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        future_value<T>&& value = static_cast<future_state<T>&>(state).move_value();
+
+        if (value.index() == 1)
+        {
+          _state->set_value(std::move(value));
+        }
+        else
+        {
+          try
+          {
+            if constexpr (is_future_v<future_catch_invoke_result_t<Func>>)
+            {
+              auto fut = std::invoke(std::move(_func), std::get<std::exception_ptr>(std::move(value)));
+
+              return attach_future(std::move(fut._state), std::move(_state));
+            }
+            else
+            {
+              invoke_future_catch<result_type>(
+                *_state, std::get<std::exception_ptr>(std::move(value)), std::move(_func));
+            }
+          }
+          catch (...)
+          {
+            _state->set_value(std::current_exception());
+          }
+        }
+
+        future_next_ptr next = _state->next();
+
+        return {std::move(next), std::move(_state)};
+      }
+
+    private:
+      Func _func;
+      std::shared_ptr<future_state<result_type>> _state;
+    };
+
+    struct executor_task
+    {
+      executor_task() = default;
+      virtual ~executor_task() = default;
+
+      executor_task(const executor_task& that) = delete;
+      executor_task& operator=(const executor_task& that) = delete;
+
+      virtual void run() = 0;
+
+      executor_task* _next = nullptr;
+      std::chrono::steady_clock::time_point _posted;
+    };
+
+    using executor_task_ptr = std::unique_ptr<executor_task>;
+
+    template <typename Func>
+    struct executor_function : executor_task
+    {
+      template <typename Arg>
+      explicit executor_function(Arg&& func)
+        : executor_task{}
+        , _func(std::forward<Arg>(func))
+      {
+      }
+
+      void run() override
+      {
+        std::invoke(_func);
+      }
+
+    private:
+      Func _func;
+    };
+
+    /*
+     * Continuation posted to an executor together with the value it continues with
+     */
+    template <typename T>
+    struct future_deferred : executor_task
+    {
+      future_deferred(future_value<T>&& value, future_next_ptr&& continuation)
+        : executor_task{}
+        , _continuation(std::move(continuation))
+      {
+        _source.set_value_unsafe(std::move(value));
+      }
+
+      void run() override
+      {
+        execute_future(_continuation->continue_with(_source));
+      }
+
+    private:
+      future_state<T> _source;
+      future_next_ptr _continuation;
+    };
+
+    template <typename T, typename Executor>
+    struct future_dispatch : future_continuation
+    {
+      future_dispatch(Executor& executor, priority prio, future_next_ptr&& continuation)
+        : future_continuation{}
+        , _executor(executor)
+        , _priority(prio)
+        , _continuation(std::move(continuation))
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        _executor.post(
+          _priority,
+          executor_task_ptr(std::make_unique<future_deferred<T>>(
+            static_cast<future_state<T>&>(state).move_value(), std::move(_continuation))));
+
+        return {};
+      }
+
+    private:
+      Executor& _executor;
+      priority _priority;
+      future_next_ptr _continuation;
+    };
+
+  } // namespace detail
+
+  template <typename T>
+  class future
+  {
+    friend detail::future_helper;
+
+    static_assert(detail::is_valid_future_value_v<T>, "T must not be any of the types used internally.");
+
+  public:
+    future() = default;
+    future(const future& that) = delete;
+    future(future&& that) = default;
+
+    future& operator=(const future& that) = delete;
+    future& operator=(future&& that) = default;
+
+    [[nodiscard]] bool valid() const noexcept
+    {
+      return (_state != nullptr);
+    }
+
+    [[nodiscard]] bool ready() const YOLO_NOEXCEPT
+    {
+      return _state && _state->ready();
+    }
+
+    template <typename Func>
+    future<detail::future_then_result_t<T, std::decay_t<Func>>> then(Func&& func)
+    {
+      using result_type = detail::future_then_result_t<T, std::decay_t<Func>>;
+      using continuation_type = detail::future_then<T, std::decay_t<Func>>;
+
+      check();
+
+      future<result_type> fut;
+      fut._state = std::make_shared<detail::future_state<result_type>>(_state->successor());
+
+      detail::future_next_ptr next =
+        _state->chain(std::make_unique<continuation_type>(std::forward<Func>(func), fut._state));
+
+      detail::execute_future({std::move(next), std::move(_state)});
+
+      return fut;
+    }
+
+    /*
+     * Runs func on the executor in the lane of the given priority
+     */
+    template <typename Executor, typename Func>
+    future<detail::future_then_result_t<T, std::decay_t<Func>>> then(Executor& executor, priority prio, Func&& func)
+    {
+      using result_type = detail::future_then_result_t<T, std::decay_t<Func>>;
+      using continuation_type = detail::future_then<T, std::decay_t<Func>>;
+      using dispatch_type = detail::future_dispatch<T, Executor>;
+
+      check();
+
+      future<result_type> fut;
+      fut._state = std::make_shared<detail::future_state<result_type>>(_state->successor());
+
+      detail::future_next_ptr next = _state->chain(std::make_unique<dispatch_type>(
+        executor, prio, std::make_unique<continuation_type>(std::forward<Func>(func), fut._state)));
+
+      detail::execute_future({std::move(next), std::move(_state)});
+
+      return fut;
+    }
+
+    template <typename Func>
+    future<detail::future_catch_result_t<T, std::decay_t<Func>>> catch_exception(Func&& func)
+    {
+      using result_type = detail::future_catch_result_t<T, std::decay_t<Func>>;
+      using continuation_type = detail::future_catch<T, std::decay_t<Func>>;
+
+      check();
+
+      future<result_type> fut;
+      fut._state = std::make_shared<detail::future_state<result_type>>(_state->successor());
+
+      detail::future_next_ptr next =
+        _state->chain(std::make_unique<continuation_type>(std::forward<Func>(func), fut._state));
+
+      detail::execute_future({std::move(next), std::move(_state)});
+
+      return fut;
+    }
+
+  private:
+    template <typename U>
+    friend class future;
+    template <typename U, typename Func>
+    friend struct detail::future_then;
+    template <typename U, typename Func>
+    friend struct detail::future_catch;
+
+    std::shared_ptr<detail::future_state<T>> _state;
+
+    void check() const
+    {
+      if (!_state)
+        detail::throw_future_error("invalid future");
+    }
+  };
+
+  namespace detail
+  {
+    template <typename T>
+    struct promise_base
+    {
+      std::shared_ptr<detail::future_state<T>> _state;
+
+      promise_base() = default;
+      promise_base(const promise_base& that) = delete;
+      promise_base(promise_base&& that) = default;
+
+      promise_base& operator=(const promise_base& that) = delete;
+      promise_base& operator=(promise_base&& that) = default;
+
+      ~promise_base()
+      {
+        if (_state)
+          satisfy(make_future_error("broken promise"));
+      }
+
+      void check() const
+      {
+        if (!_state)
+          throw_future_error("promise already satisfied");
+      }
+
+      template <typename Arg>
+      void satisfy(Arg&& arg)
+      {
+        _state->set_value(std::forward<Arg>(arg));
+
+        future_next_ptr next = _state->next();
+
+        execute_future({std::move(next), std::move(_state)});
+      }
+    };
+
+  } // namespace detail
+
+  template <typename T>
+  class promise : private detail::promise_base<T>
+  {
+    friend detail::future_helper;
+
+    static_assert(detail::is_valid_future_value_v<T>, "T must not be any of the types used internally.");
+
+  public:
+    promise() = default;
+    promise(const promise& that) = delete;
+    promise(promise&& that) = default;
+
+    promise& operator=(const promise& that) = delete;
+    promise& operator=(promise&& that) = default;
+
+    void set_value(const T& value)
+    {
+      this->check();
+      this->satisfy(value);
+    }
+
+    void set_value(T&& value)
+    {
+      this->check();
+      this->satisfy(std::move(value));
+    }
+
+    void set_exception(const std::exception_ptr& ex)
+    {
+      this->check();
+      this->satisfy(ex);
+    }
+
+    void set_exception(std::exception_ptr&& ex)
+    {
+      this->check();
+      this->satisfy(std::move(ex));
+    }
+  };
+
+  template <>
+  class promise<void> : private detail::promise_base<void>
+  {
+    friend detail::future_helper;
+
+  public:
+    promise() = default;
+    promise(const promise& that) = delete;
+    promise(promise&& that) = default;
+
+    promise& operator=(const promise& that) = delete;
+    promise& operator=(promise&& that) = default;
+
+    void set_value()
+    {
+      this->check();
+      this->satisfy(detail::future_void{});
+    }
+
+    void set_exception(const std::exception_ptr& ex)
+    {
+      this->check();
+      this->satisfy(ex);
+    }
+
+    void set_exception(std::exception_ptr&& ex)
+    {
+      this->check();
+      this->satisfy(std::move(ex));
+    }
+  };
+
+  namespace detail
+  {
+    struct future_helper
+    {
+      template <typename T>
+      static std::pair<promise<T>, future<T>> make(future_origin origin = {})
+      {
+        promise<T> prm;
+        future<T> fut;
+
+        prm._state = fut._state = std::make_shared<future_state<T>>(origin);
+
+        return {std::move(prm), std::move(fut)};
+      }
+
+      template <typename T, typename Arg>
+      static future<T> make_ready(Arg&& arg)
+      {
+        future<T> fut;
+
+        fut._state = std::make_shared<future_state<T>>();
+        fut._state->set_value_unsafe(std::forward<Arg>(arg));
+
+        return fut;
+      }
+
+      template <typename T>
+      static std::shared_ptr<future_state<T>>& state(future<T>& fut) noexcept
+      {
+        return fut._state;
+      }
+
+    };
+
+  } // namespace detail
+
+#if defined(YOLO_FUTURE_REGISTRY)
+  template <typename T>
+  [[nodiscard]] std::pair<promise<T>, future<T>> make_promise(detail::future_site site = detail::future_site::current())
+  {
+    return detail::future_helper::make<T>(detail::future_origin{site});
+  }
+
+  struct future_info
+  {
+    const char* file = nullptr;
+    unsigned line = 0;
+    // Number of continuations between the state and the promise which started the chain
+    std::size_t depth = 0;
+    std::chrono::steady_clock::duration age{0};
+  };
+
+  /*
+   * Returns up to count unsatisfied future states of all threads, the oldest first
+   */
+  [[nodiscard]] std::vector<future_info> oldest_pending_futures(std::size_t count);
+
+  /*
+   * Writes oldest_pending_futures(count) to out, one state per line
+   */
+  void dump_pending_futures(std::FILE* out, std::size_t count = 16);
+#else
+  template <typename T>
+  [[nodiscard]] std::pair<promise<T>, future<T>> make_promise()
+  {
+    return detail::future_helper::make<T>();
+  }
+#endif
+
+  template <typename T>
+  [[nodiscard]] future<std::decay_t<T>> make_ready_future(T&& value)
+  {
+    return detail::future_helper::make_ready<std::decay_t<T>>(std::forward<T>(value));
+  }
+
+  template <typename T, typename Arg>
+  [[nodiscard]] future<T> make_ready_future(Arg&& value)
+  {
+    return detail::future_helper::make_ready<T>(std::forward<Arg>(value));
+  }
+
+  template <typename T>
+  [[nodiscard]] future<T> make_exceptional_future(const std::exception_ptr& ex)
+  {
+    return detail::future_helper::make_ready<T>(ex);
+  }
+
+  template <typename T>
+  [[nodiscard]] future<T> make_exceptional_future(std::exception_ptr&& ex)
+  {
+    return detail::future_helper::make_ready<T>(std::move(ex));
+  }
+
+  /*
+   * Instantiated once in Future.cpp for the most common value types. This only saves about 1% of compile time,
+   * most of it is spent in the standard headers, which is why every subsystem lives in a header of its own.
+   */
+  extern template struct detail::future_state<void>;
+  extern template struct detail::future_state<int>;
+  extern template struct detail::future_state<bool>;
+  extern template struct detail::future_state<std::string>;
+
+  extern template struct detail::promise_base<void>;
+  extern template struct detail::promise_base<int>;
+  extern template struct detail::promise_base<bool>;
+  extern template struct detail::promise_base<std::string>;
+
+  extern template class future<void>;
+  extern template class future<int>;
+  extern template class future<bool>;
+  extern template class future<std::string>;
+
+  extern template class promise<int>;
+  extern template class promise<bool>;
+  extern template class promise<std::string>;
+
+#if !defined(YOLO_FUTURE_REGISTRY)
+  extern template std::pair<promise<void>, future<void>> make_promise<void>();
+  extern template std::pair<promise<int>, future<int>> make_promise<int>();
+  extern template std::pair<promise<bool>, future<bool>> make_promise<bool>();
+  extern template std::pair<promise<std::string>, future<std::string>> make_promise<std::string>();
+#endif
+
+} // namespace yolo
+
+#endif
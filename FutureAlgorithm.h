@@ -0,0 +1,558 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_ALGORITHM_H
+#define YOLO_FUTURE_ALGORITHM_H
+
+#include "Future.h"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace yolo
+{
+  struct parallel_options
+  {
+    // Number of tasks posted to the executor, zero means one per hardware thread
+    std::size_t tasks = 0;
+
+    // Chunk sizes are adapted so that processing one chunk takes about this long
+    std::chrono::nanoseconds chunk_time = std::chrono::microseconds(100);
+  };
+
+  namespace detail
+  {
+    struct future_counter
+    {
+      explicit future_counter(std::size_t value = 0) noexcept
+        : _value(value)
+      {
+      }
+
+      std::size_t fetch_add(std::size_t value) noexcept
+      {
+#if defined(YOLO_SINGLE_THREADED)
+        return std::exchange(_value, _value + value);
+#else
+        return _value.fetch_add(value, std::memory_order_acq_rel);
+#endif
+      }
+
+      std::size_t fetch_sub(std::size_t value) noexcept
+      {
+#if defined(YOLO_SINGLE_THREADED)
+        return std::exchange(_value, _value - value);
+#else
+        return _value.fetch_sub(value, std::memory_order_acq_rel);
+#endif
+      }
+
+      void store(std::size_t value) noexcept
+      {
+#if defined(YOLO_SINGLE_THREADED)
+        _value = value;
+#else
+        _value.store(value, std::memory_order_release);
+#endif
+      }
+
+    private:
+#if defined(YOLO_SINGLE_THREADED)
+      std::size_t _value;
+#else
+      std::atomic<std::size_t> _value;
+#endif
+    };
+
+    /*
+     * Every task claims adaptively sized chunks from a shared cursor and folds them into a partial result.
+     * The partial results are combined in a binary tree: whichever child arrives second at a node reduces
+     * both sides and moves up, so the join has logarithmic depth instead of a serial chain.
+     */
+    template <typename Iterator, typename T, typename Map, typename Reduce>
+    struct parallel_reduce
+    {
+      using partial_type = std::optional<T>;
+      using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+
+      struct join_node
+      {
+        future_counter _arrivals;
+        partial_type _partials[2];
+      };
+
+      parallel_reduce(
+        Iterator first,
+        std::size_t count,
+        std::size_t tasks,
+        std::chrono::nanoseconds chunk_time,
+        T&& init,
+        Map&& map,
+        Reduce&& reduce,
+        promise<T>&& prm)
+        : _first(first)
+        , _count(count)
+        , _tasks(tasks)
+        , _chunk_time(chunk_time)
+        , _init(std::move(init))
+        , _map(std::move(map))
+        , _reduce(std::move(reduce))
+        , _nodes(tasks)
+        , _promise(std::move(prm))
+      {
+      }
+
+      void run(std::size_t task)
+      {
+        partial_type partial;
+
+        try
+        {
+          std::size_t chunk = std::max<std::size_t>(_count / (_tasks * 64), 1);
+
+          for (;;)
+          {
+            const std::size_t begin = _cursor.fetch_add(chunk);
+
+            if (begin >= _count)
+              break;
+
+            const std::size_t end = std::min(begin + chunk, _count);
+            const auto start = std::chrono::steady_clock::now();
+
+            const Iterator last = std::next(_first, static_cast<difference_type>(end));
+
+            for (Iterator it = std::next(_first, static_cast<difference_type>(begin)); it != last; ++it)
+            {
+              if (partial)
+                partial = std::invoke(_reduce, std::move(*partial), std::invoke(_map, *it));
+              else
+                partial.emplace(std::invoke(_map, *it));
+            }
+
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            if (elapsed < _chunk_time / 2)
+              chunk *= 2;
+            else if ((elapsed > _chunk_time * 2) && (chunk > 1))
+              chunk /= 2;
+          }
+        }
+        catch (...)
+        {
+          partial.reset();
+
+          if (_failed.claim())
+            _exception = std::current_exception();
+
+          _cursor.store(_count);
+        }
+
+        join(_tasks + task, std::move(partial));
+      }
+
+    private:
+      Iterator _first;
+      std::size_t _count;
+      std::size_t _tasks;
+      std::chrono::nanoseconds _chunk_time;
+      T _init;
+      Map _map;
+      Reduce _reduce;
+      future_counter _cursor;
+      future_flag _failed;
+      std::exception_ptr _exception;
+      std::vector<join_node> _nodes;
+      promise<T> _promise;
+
+      void join(std::size_t index, partial_type&& partial)
+      {
+        for (; index > 1; index /= 2)
+        {
+          join_node& node = _nodes[index / 2];
+
+          node._partials[index % 2] = std::move(partial);
+
+          if (node._arrivals.fetch_add(1) == 0)
+            return;
+
+          partial = combine(std::move(node._partials[0]), std::move(node._partials[1]));
+        }
+
+        complete(std::move(partial));
+      }
+
+      [[nodiscard]] partial_type combine(partial_type&& lhs, partial_type&& rhs)
+      {
+        if (!lhs || !rhs)
+          return lhs ? std::move(lhs) : std::move(rhs);
+
+        try
+        {
+          return std::invoke(_reduce, std::move(*lhs), std::move(*rhs));
+        }
+        catch (...)
+        {
+          if (_failed.claim())
+            _exception = std::current_exception();
+
+          return std::nullopt;
+        }
+      }
+
+      void complete(partial_type&& partial)
+      {
+        if (_exception)
+        {
+          _promise.set_exception(std::move(_exception));
+          return;
+        }
+
+        if (partial)
+        {
+          try
+          {
+            _init = std::invoke(_reduce, std::move(_init), std::move(*partial));
+          }
+          catch (...)
+          {
+            _promise.set_exception(std::current_exception());
+            return;
+          }
+        }
+
+        _promise.set_value(std::move(_init));
+      }
+    };
+
+    template <typename Executor, typename Range, typename T, typename Map, typename Reduce>
+    [[nodiscard]] future<T> parallel_transform_reduce(
+      Executor& executor,
+      Range& range,
+      T init,
+      Map map,
+      Reduce reduce,
+      const parallel_options& options)
+    {
+      using iterator_type = decltype(std::begin(range));
+      using state_type = parallel_reduce<iterator_type, T, Map, Reduce>;
+
+      static_assert(
+        std::is_base_of_v<
+          std::random_access_iterator_tag,
+          typename std::iterator_traits<iterator_type>::iterator_category>,
+        "The range must provide random access iterators.");
+
+      const auto count = static_cast<std::size_t>(std::distance(std::begin(range), std::end(range)));
+
+      if (count == 0)
+        return future_helper::make_ready<T>(std::move(init));
+
+      std::size_t tasks = options.tasks;
+
+      if (tasks == 0)
+        tasks = std::thread::hardware_concurrency();
+
+      tasks = std::clamp<std::size_t>(tasks, 1, count);
+
+      auto [prm, fut] = make_promise<T>();
+
+      auto state = std::make_shared<state_type>(
+        std::begin(range),
+        count,
+        tasks,
+        options.chunk_time,
+        std::move(init),
+        std::move(map),
+        std::move(reduce),
+        std::move(prm));
+
+      for (std::size_t task = 0; task < tasks; ++task)
+        executor.post([state, task]() { state->run(task); });
+
+      return std::move(fut);
+    }
+
+  } // namespace detail
+
+  /*
+   * Maps all elements of range and folds the results with init. Reduce must be associative and
+   * commutative, the order of evaluation is unspecified. The range must outlive the returned future.
+   */
+  template <typename Executor, typename Range, typename T, typename Map, typename Reduce>
+  [[nodiscard]] future<std::decay_t<T>> transform_reduce(
+    Executor& executor,
+    Range& range,
+    T&& init,
+    Map&& map,
+    Reduce&& reduce,
+    const parallel_options& options = {})
+  {
+    return detail::parallel_transform_reduce(
+      executor,
+      range,
+      std::decay_t<T>(std::forward<T>(init)),
+      std::decay_t<Map>(std::forward<Map>(map)),
+      std::decay_t<Reduce>(std::forward<Reduce>(reduce)),
+      options);
+  }
+
+  /*
+   * Invokes func on all elements of range. The range must outlive the returned future.
+   */
+  template <typename Executor, typename Range, typename Func>
+  [[nodiscard]] future<void> parallel_for(
+    Executor& executor,
+    Range& range,
+    Func&& func,
+    const parallel_options& options = {})
+  {
+    auto map = [func = std::decay_t<Func>(std::forward<Func>(func))](auto&& value) mutable {
+      std::invoke(func, std::forward<decltype(value)>(value));
+
+      return detail::future_void{};
+    };
+
+    auto reduce = [](detail::future_void, detail::future_void) { return detail::future_void{}; };
+
+    return detail::parallel_transform_reduce(
+             executor, range, detail::future_void{}, std::move(map), std::move(reduce), options)
+      .then([](detail::future_void) {});
+  }
+
+  namespace detail
+  {
+    /*
+     * Keeps at most a given number of futures in flight. A completion frees a lane and the next element
+     * is started by whichever thread is currently pumping, so ready futures don't recurse.
+     */
+    template <typename Iterator, typename Func, typename T>
+    struct bounded_map_state : std::enable_shared_from_this<bounded_map_state<Iterator, Func, T>>
+    {
+      bounded_map_state(
+        Iterator first,
+        std::size_t count,
+        std::size_t lanes,
+        Func&& func,
+        promise<std::vector<T>>&& prm)
+        : _first(first)
+        , _func(std::move(func))
+        , _count(count)
+        , _results(count)
+        , _remaining(count)
+        , _credits(lanes)
+        , _promise(std::move(prm))
+      {
+      }
+
+      void pump()
+      {
+        for (;;)
+        {
+          std::size_t index = 0;
+
+          {
+#if !defined(YOLO_SINGLE_THREADED)
+            const std::lock_guard lock(_mutex);
+#endif
+
+            if ((_credits == 0) || (_next == _count))
+            {
+              _pumping = false;
+              return;
+            }
+
+            index = _next++;
+            --_credits;
+          }
+
+          start(index);
+        }
+      }
+
+      void complete(std::size_t index, future_value<T>&& value)
+      {
+        if (value.index() == 1)
+          _results[index].emplace(std::get<1>(std::move(value)));
+        else if (_failed.claim())
+          _exception = std::get<std::exception_ptr>(std::move(value));
+
+        bool finished = false;
+        bool pumping = false;
+
+        {
+#if !defined(YOLO_SINGLE_THREADED)
+          const std::lock_guard lock(_mutex);
+#endif
+
+          if ((value.index() != 1) && (_next < _count))
+          {
+            // Elements which will never be started count as done
+            _remaining -= _count - _next;
+            _next = _count;
+          }
+
+          ++_credits;
+          finished = (--_remaining == 0);
+          pumping = std::exchange(_pumping, true);
+        }
+
+        if (finished)
+          finish();
+        else if (!pumping)
+          pump();
+      }
+
+    private:
+#if !defined(YOLO_SINGLE_THREADED)
+      std::mutex _mutex;
+#endif
+
+      Iterator _first;
+      Func _func;
+      std::size_t _count;
+      std::vector<std::optional<T>> _results;
+      std::size_t _next = 0;
+      std::size_t _remaining;
+      std::size_t _credits;
+      bool _pumping = true;
+      future_flag _failed;
+      std::exception_ptr _exception;
+      promise<std::vector<T>> _promise;
+
+      void start(std::size_t index);
+
+      void finish()
+      {
+        if (_exception)
+        {
+          _promise.set_exception(std::move(_exception));
+          return;
+        }
+
+        std::vector<T> results;
+        results.reserve(_results.size());
+
+        for (std::optional<T>& result : _results)
+          results.push_back(std::move(*result));
+
+        _results.clear();
+
+        _promise.set_value(std::move(results));
+      }
+    };
+
+    template <typename State, typename T>
+    struct bounded_map_completion : future_continuation
+    {
+      bounded_map_completion(std::shared_ptr<State> state, std::size_t index)
+        : future_continuation{}
+        , _state(std::move(state))
+        , _index(index)
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        _state->complete(_index, static_cast<future_state<T>&>(state).move_value());
+
+        return {};
+      }
+
+    private:
+      std::shared_ptr<State> _state;
+      std::size_t _index;
+    };
+
+    template <typename Iterator, typename Func, typename T>
+    void bounded_map_state<Iterator, Func, T>::start(std::size_t index)
+    {
+      future<T> fut;
+
+      try
+      {
+        using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+
+        fut = std::invoke(_func, *std::next(_first, static_cast<difference_type>(index)));
+
+        if (!fut.valid())
+          throw_future_error("invalid future");
+      }
+      catch (...)
+      {
+        complete(index, std::current_exception());
+        return;
+      }
+
+      std::shared_ptr<future_state<T>>& state = future_helper::state(fut);
+
+      future_next_ptr next = state->chain(
+        std::make_unique<bounded_map_completion<bounded_map_state, T>>(this->shared_from_this(), index));
+
+      execute_future({std::move(next), std::move(state)});
+    }
+
+  } // namespace detail
+
+  /*
+   * Invokes func, which returns a future, on the elements of range with at most max_in_flight of them
+   * pending at any time. The results are returned in the order of range, which must outlive the returned
+   * future. After the first failure no further elements are started and the exception is propagated.
+   */
+  template <typename Range, typename Func>
+  [[nodiscard]] auto bounded_map(Range& range, std::size_t max_in_flight, Func&& func)
+  {
+    using iterator_type = decltype(std::begin(range));
+    using func_type = std::decay_t<Func>;
+    using result_type = std::decay_t<std::invoke_result_t<func_type&, decltype(*std::begin(range))>>;
+    using value_type = detail::future_unwrap_t<result_type>;
+    using state_type = detail::bounded_map_state<iterator_type, func_type, value_type>;
+
+    static_assert(detail::is_future_v<result_type>, "The function must return a future.");
+
+    const auto count = static_cast<std::size_t>(std::distance(std::begin(range), std::end(range)));
+
+    if (count == 0)
+      return make_ready_future(std::vector<value_type>{});
+
+    auto [prm, fut] = make_promise<std::vector<value_type>>();
+
+    auto state = std::make_shared<state_type>(
+      std::begin(range),
+      count,
+      std::max<std::size_t>(max_in_flight, 1),
+      func_type(std::forward<Func>(func)),
+      std::move(prm));
+
+    state->pump();
+
+    return std::move(fut);
+  }
+
+} // namespace yolo
+
+#endif
@@ -0,0 +1,463 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_ARRAY_H
+#define YOLO_FUTURE_ARRAY_H
+
+#include "Future.h"
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace yolo
+{
+  namespace detail
+  {
+    template <typename T>
+    struct future_array_state;
+
+    template <typename T>
+    struct future_array_completion
+    {
+      future_array_completion() = default;
+      virtual ~future_array_completion() = default;
+
+      future_array_completion(const future_array_completion& that) = delete;
+      future_array_completion& operator=(const future_array_completion& that) = delete;
+
+      virtual void complete(const future_array_state<T>& state) = 0;
+    };
+
+    /*
+     * Values of all slots in one contiguous buffer, readiness and failure are tracked in bitmaps. Exceptions
+     * are expected to be rare and are kept aside.
+     */
+    template <typename T>
+    struct future_array_state
+    {
+      static constexpr std::size_t word_bits = 64;
+
+      explicit future_array_state(std::size_t size)
+        : _size(size)
+        , _values(std::make_unique<T[]>(size))
+        , _ready((size + word_bits - 1) / word_bits)
+        , _failed(_ready.size())
+        , _visited(_ready.size())
+        , _pending(size)
+      {
+      }
+
+      [[nodiscard]] std::size_t size() const noexcept
+      {
+        return _size;
+      }
+
+      [[nodiscard]] std::size_t pending() const
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        return _pending;
+      }
+
+      [[nodiscard]] bool ready(std::size_t index) const
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        return (_ready[index / word_bits] & bit(index)) != 0;
+      }
+
+      [[nodiscard]] std::exception_ptr exception(std::size_t index) const
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        const auto it = _exceptions.find(index);
+
+        return (it != _exceptions.end()) ? it->second : std::exception_ptr{};
+      }
+
+      void complete(std::size_t index, future_value<T>&& value)
+      {
+        std::vector<std::unique_ptr<future_array_completion<T>>> completions;
+
+        {
+#if !defined(YOLO_SINGLE_THREADED)
+          const std::lock_guard lock(_mutex);
+#endif
+
+          std::uint64_t& ready = _ready[index / word_bits];
+
+          if (ready & bit(index))
+            throw_future_error("promise already satisfied");
+
+          if (value.index() == 1)
+            _values[index] = std::get<1>(std::move(value));
+          else
+          {
+            _failed[index / word_bits] |= bit(index);
+            _exceptions.emplace(index, std::get<std::exception_ptr>(std::move(value)));
+          }
+
+          ready |= bit(index);
+
+          if (--_pending == 0)
+            completions = std::move(_completions);
+        }
+
+        for (const auto& completion : completions)
+          completion->complete(*this);
+      }
+
+      /*
+       * Runs completion once all slots are ready
+       */
+      void when_complete(std::unique_ptr<future_array_completion<T>> completion)
+      {
+        {
+#if !defined(YOLO_SINGLE_THREADED)
+          const std::lock_guard lock(_mutex);
+#endif
+
+          if (_pending != 0)
+          {
+            _completions.push_back(std::move(completion));
+            return;
+          }
+        }
+
+        completion->complete(*this);
+      }
+
+      /*
+       * Passes each run of ready values not visited before to func(first, values, count). Runs continue
+       * across bitmap words, failed slots and slots which are still pending end a run.
+       */
+      template <typename Func>
+      std::size_t visit(Func& func)
+      {
+        std::size_t total = 0;
+        std::size_t first = 0;
+        std::size_t count = 0;
+
+        const auto flush = [&]() {
+          if (count == 0)
+            return;
+
+          std::invoke(func, first, static_cast<const T*>(_values.get() + first), count);
+
+          total += count;
+          count = 0;
+        };
+
+        for (std::size_t word = 0; word < _ready.size(); ++word)
+        {
+          std::uint64_t fresh = 0;
+          std::uint64_t values = 0;
+
+          {
+#if !defined(YOLO_SINGLE_THREADED)
+            const std::lock_guard lock(_mutex);
+#endif
+
+            fresh = _ready[word] & ~_visited[word];
+            values = fresh & ~_failed[word];
+
+            _visited[word] |= fresh;
+          }
+
+          while (values != 0)
+          {
+            const auto offset = static_cast<std::size_t>(__builtin_ctzll(values));
+            const std::uint64_t gaps = ~(values >> offset);
+            const std::size_t length =
+              (gaps == 0) ? (word_bits - offset) : static_cast<std::size_t>(__builtin_ctzll(gaps));
+            const std::size_t index = (word * word_bits) + offset;
+
+            if ((count == 0) || (first + count != index))
+            {
+              flush();
+              first = index;
+            }
+
+            count += length;
+            values &= ~(low_bits(length) << offset);
+          }
+        }
+
+        flush();
+
+        return total;
+      }
+
+      /*
+       * Folds all values in slot order, rethrows the exception of the first failed slot instead
+       */
+      template <typename U, typename Op>
+      [[nodiscard]] U reduce(U init, Op& op) const
+      {
+        for (std::size_t word = 0; word < _failed.size(); ++word)
+        {
+          if (_failed[word] != 0)
+          {
+            const auto offset = static_cast<std::size_t>(__builtin_ctzll(_failed[word]));
+
+            std::rethrow_exception(_exceptions.at((word * word_bits) + offset));
+          }
+        }
+
+        for (std::size_t i = 0; i < _size; ++i)
+          init = std::invoke(op, std::move(init), _values[i]);
+
+        return init;
+      }
+
+    private:
+#if !defined(YOLO_SINGLE_THREADED)
+      mutable std::mutex _mutex;
+#endif
+
+      std::size_t _size;
+      std::unique_ptr<T[]> _values;
+      std::vector<std::uint64_t> _ready;
+      std::vector<std::uint64_t> _failed;
+      std::vector<std::uint64_t> _visited;
+      std::unordered_map<std::size_t, std::exception_ptr> _exceptions;
+      std::size_t _pending;
+      std::vector<std::unique_ptr<future_array_completion<T>>> _completions;
+
+      [[nodiscard]] static constexpr std::uint64_t bit(std::size_t index) noexcept
+      {
+        return std::uint64_t{1} << (index % word_bits);
+      }
+
+      [[nodiscard]] static constexpr std::uint64_t low_bits(std::size_t count) noexcept
+      {
+        return (count >= word_bits) ? ~std::uint64_t{0} : (std::uint64_t{1} << count) - 1;
+      }
+    };
+
+    template <typename T>
+    struct future_array_slot : future_continuation
+    {
+      future_array_slot(std::shared_ptr<future_array_state<T>> state, std::size_t index)
+        : future_continuation{}
+        , _state(std::move(state))
+        , _index(index)
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        _state->complete(_index, static_cast<future_state<T>&>(state).move_value());
+
+        return {};
+      }
+
+    private:
+      std::shared_ptr<future_array_state<T>> _state;
+      std::size_t _index;
+    };
+
+    template <typename T, typename U, typename Op>
+    struct future_array_reduce : future_array_completion<T>
+    {
+      future_array_reduce(U&& init, Op&& op, promise<U>&& prm)
+        : _init(std::move(init))
+        , _op(std::move(op))
+        , _promise(std::move(prm))
+      {
+      }
+
+      void complete(const future_array_state<T>& state) override
+      {
+        try
+        {
+          _promise.set_value(state.reduce(std::move(_init), _op));
+        }
+        catch (...)
+        {
+          _promise.set_exception(std::current_exception());
+        }
+      }
+
+    private:
+      U _init;
+      Op _op;
+      promise<U> _promise;
+    };
+
+  } // namespace detail
+
+  /*
+   * Fixed number of homogeneous futures sharing one state with the values stored contiguously
+   *
+   * Slots are satisfied with set_value() or by the futures the array was constructed from. Instead of a
+   * continuation per slot, then_each() and reduce() run a single functor over runs of ready values, which
+   * lends itself to vectorized post-processing. Values of ready slots never change.
+   */
+  template <typename T>
+  class future_array
+  {
+    static_assert(detail::is_valid_future_value_v<T> && !std::is_void_v<T>, "T must be a value type.");
+    static_assert(std::is_default_constructible_v<T>, "T must be default constructible.");
+
+  public:
+    future_array() = default;
+
+    explicit future_array(std::size_t size)
+      : _state(std::make_shared<detail::future_array_state<T>>(size))
+    {
+    }
+
+    /*
+     * Each future is attached to its slot, ready futures are moved in right away
+     */
+    explicit future_array(std::vector<future<T>>&& futures)
+      : future_array(futures.size())
+    {
+      for (std::size_t i = 0; i < futures.size(); ++i)
+      {
+        std::shared_ptr<detail::future_state<T>>& state = detail::future_helper::state(futures[i]);
+
+        if (!state)
+          _state->complete(i, detail::make_future_error("invalid future"));
+        else if (state->ready())
+          _state->complete(i, state->move_value());
+        else
+        {
+          detail::future_next_ptr next =
+            state->chain(std::make_unique<detail::future_array_slot<T>>(_state, i));
+
+          detail::execute_future({std::move(next), std::move(state)});
+        }
+      }
+    }
+
+    future_array(const future_array& that) = delete;
+    future_array(future_array&& that) = default;
+
+    future_array& operator=(const future_array& that) = delete;
+    future_array& operator=(future_array&& that) = default;
+
+    [[nodiscard]] bool valid() const noexcept
+    {
+      return (_state != nullptr);
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+      return _state ? _state->size() : 0;
+    }
+
+    /*
+     * Returns the number of slots which aren't ready yet
+     */
+    [[nodiscard]] std::size_t pending() const
+    {
+      return check().pending();
+    }
+
+    [[nodiscard]] bool ready(std::size_t index) const
+    {
+      return check().ready(check_index(index));
+    }
+
+    /*
+     * Returns the exception of a failed slot or nullptr
+     */
+    [[nodiscard]] std::exception_ptr exception(std::size_t index) const
+    {
+      return check().exception(check_index(index));
+    }
+
+    void set_value(std::size_t index, T value)
+    {
+      check().complete(check_index(index), std::move(value));
+    }
+
+    void set_exception(std::size_t index, std::exception_ptr ex)
+    {
+      check().complete(check_index(index), std::move(ex));
+    }
+
+    /*
+     * Invokes func(first, values, count) for each run of ready values which weren't passed before, where
+     * values points to count contiguous values starting at slot first. Failed slots are skipped. Returns
+     * the number of values passed, call it again to pick up slots which got ready since.
+     */
+    template <typename Func>
+    std::size_t then_each(Func&& func)
+    {
+      return check().visit(func);
+    }
+
+    /*
+     * Folds the values in slot order with op(U, const T&) once all slots are ready. Fails with the
+     * exception of the first failed slot.
+     */
+    template <typename U, typename Op>
+    [[nodiscard]] future<U> reduce(U init, Op&& op)
+    {
+      using reduce_type = detail::future_array_reduce<T, U, std::decay_t<Op>>;
+
+      detail::future_array_state<T>& state = check();
+
+      auto [prm, fut] = make_promise<U>();
+
+      state.when_complete(
+        std::make_unique<reduce_type>(std::move(init), std::decay_t<Op>(std::forward<Op>(op)), std::move(prm)));
+
+      return std::move(fut);
+    }
+
+  private:
+    std::shared_ptr<detail::future_array_state<T>> _state;
+
+    [[nodiscard]] detail::future_array_state<T>& check() const
+    {
+      if (!_state)
+        detail::throw_future_error("invalid future");
+
+      return *_state;
+    }
+
+    [[nodiscard]] std::size_t check_index(std::size_t index) const
+    {
+      if (index >= _state->size())
+        throw std::out_of_range("future_array index out of range");
+
+      return index;
+    }
+  };
+
+} // namespace yolo
+
+#endif
@@ -0,0 +1,443 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Future.h"
+#include "FutureArray.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Counts all allocations, the benchmark reports the ones made while measuring
+ */
+namespace
+{
+  std::atomic<std::size_t> allocations{0};
+  std::atomic<std::size_t> allocated_bytes{0};
+
+} // namespace
+
+// Not inlined, otherwise GCC pairs free() with the new expression and warns about a mismatch
+[[gnu::noinline]] void* operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  if (void* ptr = std::malloc(size ? size : 1))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+[[gnu::noinline]] void* operator new(std::size_t size, std::align_val_t align)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+  const auto alignment = static_cast<std::size_t>(align);
+
+  if (void* ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+namespace
+{
+  // Written by concurrent benchmarks, relaxed stores cost no more than plain ones
+  std::atomic<long> sink{0};
+
+  void consume(long value)
+  {
+    sink.store(value, std::memory_order_relaxed);
+  }
+
+  struct benchmark_result
+  {
+    std::string name;
+    double ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+    double bytes_per_op = 0.0;
+  };
+
+  /*
+   * Reads the ns_per_op values of a previous run in the JSON lines format written below
+   */
+  std::unordered_map<std::string, double> read_baseline(const char* path)
+  {
+    std::unordered_map<std::string, double> baseline;
+    std::ifstream file(path);
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+      const std::string name_key = "\"name\":\"";
+      const std::string ns_key = "\"ns_per_op\":";
+
+      const std::size_t name = line.find(name_key);
+      const std::size_t ns = line.find(ns_key);
+
+      if ((name == std::string::npos) || (ns == std::string::npos))
+        continue;
+
+      const std::size_t begin = name + name_key.size();
+
+      baseline[line.substr(begin, line.find('"', begin) - begin)] = std::stod(line.substr(ns + ns_key.size()));
+    }
+
+    return baseline;
+  }
+
+  /*
+   * Doubles the number of iterations until a run takes at least 100ms and reports the last run.
+   * Func performs the given number of operations and may prepare them before starting the clock.
+   */
+  template <typename Func>
+  benchmark_result measure(std::string name, Func&& func)
+  {
+    using clock = std::chrono::steady_clock;
+
+    for (std::size_t iterations = 1;; iterations *= 2)
+    {
+      clock::time_point start;
+      std::size_t start_allocations = 0;
+      std::size_t start_bytes = 0;
+
+      const auto begin = [&]() {
+        start_allocations = allocations.load(std::memory_order_relaxed);
+        start_bytes = allocated_bytes.load(std::memory_order_relaxed);
+        start = clock::now();
+      };
+
+      func(iterations, begin);
+
+      const auto elapsed = clock::now() - start;
+
+      if ((elapsed >= std::chrono::milliseconds(100)) || (iterations >= (std::size_t{1} << 30)))
+      {
+        const auto ops = static_cast<double>(iterations);
+
+        benchmark_result result;
+        result.name = std::move(name);
+        result.ns_per_op = static_cast<double>(std::chrono::nanoseconds(elapsed).count()) / ops;
+        result.allocs_per_op = static_cast<double>(allocations.load() - start_allocations) / ops;
+        result.bytes_per_op = static_cast<double>(allocated_bytes.load() - start_bytes) / ops;
+
+        return result;
+      }
+    }
+  }
+
+  void report(const benchmark_result& result, const std::unordered_map<std::string, double>& baseline)
+  {
+    std::printf(
+      "{\"name\":\"%s\",\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.2f",
+      result.name.c_str(),
+      result.ns_per_op,
+      result.allocs_per_op,
+      result.bytes_per_op);
+
+    if (const auto it = baseline.find(result.name); it != baseline.end())
+      std::printf(",\"baseline_ns_per_op\":%.2f,\"change\":%.4f", it->second, result.ns_per_op / it->second - 1.0);
+
+    std::printf("}\n");
+    std::fflush(stdout);
+  }
+
+  template <typename T>
+  void report_layout(const char* name)
+  {
+    std::printf(
+      "{\"name\":\"%s\",\"sizeof\":%zu,\"alignof\":%zu}\n",
+      name,
+      sizeof(yolo::detail::future_state<T>),
+      alignof(yolo::detail::future_state<T>));
+  }
+
+} // namespace
+
+/*
+ * Writes one JSON object per benchmark to stdout. Pass the output of a previous run to compare with it.
+ */
+int main(int argc, char** argv)
+{
+  using namespace yolo;
+
+  const auto baseline = (argc > 1) ? read_baseline(argv[1]) : std::unordered_map<std::string, double>{};
+
+  report_layout<void>("future_state_void");
+  report_layout<int>("future_state_int");
+  report_layout<std::string>("future_state_string");
+
+  report(
+    measure(
+      "promise_then",
+      [](std::size_t iterations, auto&& begin) {
+        begin();
+
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+          auto [prm, fut] = make_promise<int>();
+
+          fut.then([](int value) { consume(value); });
+          prm.set_value(static_cast<int>(i));
+        }
+      }),
+    baseline);
+
+  report(
+    measure(
+      "ready_then",
+      [](std::size_t iterations, auto&& begin) {
+        begin();
+
+        for (std::size_t i = 0; i < iterations; ++i)
+          make_ready_future(static_cast<int>(i)).then([](int value) { consume(value); });
+      }),
+    baseline);
+
+  for (std::size_t depth : {1, 10, 100, 1000})
+  {
+    report(
+      measure(
+        "chain_depth_" + std::to_string(depth),
+        [depth](std::size_t iterations, auto&& begin) {
+          begin();
+
+          for (std::size_t i = 0; i < iterations; ++i)
+          {
+            auto [prm, fut] = make_promise<int>();
+
+            for (std::size_t j = 0; j < depth; ++j)
+              fut = fut.then([](int value) { return value + 1; });
+
+            fut.then([](int value) { consume(value); });
+            prm.set_value(0);
+          }
+        }),
+      baseline);
+  }
+
+  report(
+    measure(
+      "inner_future",
+      [](std::size_t iterations, auto&& begin) {
+        begin();
+
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+          auto [prm0, fut0] = make_promise<int>();
+          auto [prm1, fut1] = make_promise<int>();
+
+          fut0.then([fut = std::move(fut1)](int lhs) mutable { return fut.then([lhs](int rhs) { return lhs + rhs; }); })
+            .then([](int value) { consume(value); });
+
+          prm0.set_value(1);
+          prm1.set_value(2);
+        }
+      }),
+    baseline);
+
+  report(
+    measure(
+      "exception_propagation",
+      [](std::size_t iterations, auto&& begin) {
+        const std::exception_ptr ex = std::make_exception_ptr(std::runtime_error("benchmark"));
+
+        begin();
+
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+          auto [prm, fut] = make_promise<int>();
+
+          fut.then([](int value) { return value + 1; })
+            .then([](int value) { return value + 1; })
+            .catch_exception([](std::exception_ptr) { return -1; })
+            .then([](int value) { consume(value); });
+
+          prm.set_exception(ex);
+        }
+      }),
+    baseline);
+
+  // The same continuation on many homogeneous futures, one operation is one element
+  report(
+    measure(
+      "then_per_future_1000",
+      [](std::size_t iterations, auto&& begin) {
+        begin();
+
+        for (std::size_t i = 0; i < iterations; i += 1000)
+        {
+          std::vector<promise<double>> promises;
+          double sum = 0.0;
+
+          promises.reserve(1000);
+
+          for (std::size_t j = 0; j < 1000; ++j)
+          {
+            auto [prm, fut] = make_promise<double>();
+
+            fut.then([&sum](double value) { sum += value; });
+            promises.push_back(std::move(prm));
+          }
+
+          for (std::size_t j = 0; j < 1000; ++j)
+            promises[j].set_value(static_cast<double>(j));
+
+          consume(static_cast<long>(sum));
+        }
+      }),
+    baseline);
+
+  report(
+    measure(
+      "future_array_1000",
+      [](std::size_t iterations, auto&& begin) {
+        begin();
+
+        for (std::size_t i = 0; i < iterations; i += 1000)
+        {
+          future_array<double> array(1000);
+
+          array.reduce(0.0, [](double lhs, double rhs) { return lhs + rhs; }).then([](double sum) {
+            consume(static_cast<long>(sum));
+          });
+
+          for (std::size_t j = 0; j < 1000; ++j)
+            array.set_value(j, static_cast<double>(j));
+        }
+      }),
+    baseline);
+
+#if !defined(YOLO_SINGLE_THREADED)
+  report(
+    measure(
+      "producer_consumer",
+      [](std::size_t iterations, auto&& begin) {
+        std::vector<promise<int>> promises;
+        std::vector<future<int>> futures;
+
+        promises.reserve(iterations);
+        futures.reserve(iterations);
+
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+          auto [prm, fut] = make_promise<int>();
+
+          promises.push_back(std::move(prm));
+          futures.push_back(std::move(fut));
+        }
+
+        begin();
+
+        std::thread producer([&promises]() {
+          for (std::size_t i = 0; i < promises.size(); ++i)
+            promises[i].set_value(static_cast<int>(i));
+        });
+
+        for (future<int>& fut : futures)
+          fut.then([](int value) { consume(value); });
+
+        producer.join();
+      }),
+    baseline);
+
+  /*
+   * Every thread satisfies and continues its own states, which are interleaved in memory with the
+   * states of all other threads. Without YOLO_CACHE_ALIGNED neighbouring states share cache lines.
+   */
+  report(
+    measure(
+      "interleaved_states",
+      [](std::size_t iterations, auto&& begin) {
+        const std::size_t thread_count = std::max<unsigned>(std::thread::hardware_concurrency(), 2);
+        const std::size_t count = std::max(iterations, thread_count);
+
+        std::vector<promise<int>> promises;
+        std::vector<future<int>> futures;
+
+        promises.reserve(count);
+        futures.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          auto [prm, fut] = make_promise<int>();
+
+          promises.push_back(std::move(prm));
+          futures.push_back(std::move(fut));
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count);
+
+        begin();
+
+        for (std::size_t t = 0; t < thread_count; ++t)
+        {
+          threads.emplace_back([&promises, &futures, t, thread_count]() {
+            for (std::size_t i = t; i < promises.size(); i += thread_count)
+            {
+              futures[i].then([](int value) { consume(value); });
+              promises[i].set_value(static_cast<int>(i));
+            }
+          });
+        }
+
+        for (std::thread& thread : threads)
+          thread.join();
+      }),
+    baseline);
+#endif
+
+  return 0;
+}
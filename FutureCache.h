@@ -0,0 +1,334 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_CACHE_H
+#define YOLO_FUTURE_CACHE_H
+
+#include "FutureSync.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace yolo
+{
+  namespace detail
+  {
+    template <typename Cache>
+    struct async_cache_fill : future_continuation
+    {
+      using key_type = typename Cache::key_type;
+      using value_type = typename Cache::value_type;
+
+      async_cache_fill(Cache& cache, const key_type& key)
+        : future_continuation{}
+        , _cache(cache)
+        , _key(key)
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        _cache.fill(_key, static_cast<future_state<value_type>&>(state).move_value());
+
+        return {};
+      }
+
+    private:
+      Cache& _cache;
+      key_type _key;
+    };
+
+  } // namespace detail
+
+  /*
+   * Cache of asynchronously loaded values
+   *
+   * Concurrent lookups of a missing key share a single load, its result is copied to all of them.
+   * Failed loads are not cached. Every shard has its own lock and evicts with the CLOCK algorithm once
+   * its share of the capacity is used up, there are no more shards than entries. try_get() looks up
+   * completed entries without allocating a future state. The cache must outlive pending loads.
+   */
+  template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+  class async_cache
+  {
+  public:
+    using key_type = K;
+    using value_type = V;
+
+    static_assert(std::is_copy_constructible_v<V>, "V must be copy constructible.");
+
+    explicit async_cache(std::size_t capacity, std::size_t shards = 16)
+      : _shard_count(std::clamp<std::size_t>(shards, 1, std::max<std::size_t>(capacity, 1)))
+      , _shards(std::make_unique<shard[]>(_shard_count))
+    {
+      assert(capacity > 0);
+
+      // The first shards take the remainder, so the capacities add up exactly
+      for (std::size_t i = 0; i < _shard_count; ++i)
+        _shards[i]._capacity = capacity / _shard_count + ((i < capacity % _shard_count) ? 1 : 0);
+    }
+
+    async_cache(const async_cache& that) = delete;
+    async_cache& operator=(const async_cache& that) = delete;
+
+    /*
+     * Returns the cached value or joins the pending load, otherwise load(key) is invoked which must
+     * return a future<V>
+     */
+    template <typename Func>
+    [[nodiscard]] future<V> get(
+      const K& key,
+      Func&& load,
+      detail::future_site site = detail::future_site::current())
+    {
+      static_assert(
+        std::is_same_v<std::decay_t<std::invoke_result_t<Func, const K&>>, future<V>>,
+        "The load function must return a future of the value type.");
+
+      shard& s = shard_of(key);
+      std::optional<V> cached;
+      std::shared_ptr<detail::async_waiter<V>> waiter;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(s._mutex);
+#endif
+
+        if (const std::optional<V>* entry = find(s, key))
+        {
+          cached = *entry;
+        }
+        else
+        {
+          waiter = std::make_shared<detail::async_waiter<V>>(site);
+
+          const auto [it, inserted] = s._pending.try_emplace(key);
+
+          it->second.push(waiter);
+
+          if (!inserted)
+            return detail::make_waiter_future(waiter);
+        }
+      }
+
+      if (cached)
+        return make_ready_future(std::move(*cached));
+
+      future<V> fut;
+
+      try
+      {
+        fut = std::invoke(std::forward<Func>(load), key);
+
+        if (!fut.valid())
+          detail::throw_future_error("invalid future");
+      }
+      catch (...)
+      {
+        fill(key, std::current_exception());
+
+        return detail::make_waiter_future(waiter);
+      }
+
+      std::shared_ptr<detail::future_state<V>>& state = detail::future_helper::state(fut);
+
+      detail::future_next_ptr next =
+        state->chain(std::make_unique<detail::async_cache_fill<async_cache>>(*this, key));
+
+      detail::execute_future({std::move(next), std::move(state)});
+
+      return detail::make_waiter_future(waiter);
+    }
+
+    [[nodiscard]] std::optional<V> try_get(const K& key)
+    {
+      shard& s = shard_of(key);
+
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(s._mutex);
+#endif
+
+      if (const std::optional<V>* entry = find(s, key))
+        return *entry;
+
+      return std::nullopt;
+    }
+
+    void erase(const K& key)
+    {
+      shard& s = shard_of(key);
+
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(s._mutex);
+#endif
+
+      const auto it = s._index.find(key);
+
+      if (it != s._index.end())
+      {
+        s._slots[it->second] = slot{};
+        s._index.erase(it);
+      }
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+      std::size_t size = 0;
+
+      for (std::size_t i = 0; i < _shard_count; ++i)
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_shards[i]._mutex);
+#endif
+
+        size += _shards[i]._index.size();
+      }
+
+      return size;
+    }
+
+  private:
+    template <typename Cache>
+    friend struct detail::async_cache_fill;
+
+    struct slot
+    {
+      std::optional<K> _key;
+      std::optional<V> _value;
+      bool _referenced = false;
+    };
+
+    struct shard
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      mutable std::mutex _mutex;
+#endif
+
+      std::unordered_map<K, std::size_t, Hash, KeyEqual> _index;
+      std::unordered_map<K, detail::async_waiter_queue<V>, Hash, KeyEqual> _pending;
+      std::vector<slot> _slots;
+      std::size_t _hand = 0;
+      std::size_t _capacity = 0;
+    };
+
+    std::size_t _shard_count;
+    std::unique_ptr<shard[]> _shards;
+
+    [[nodiscard]] shard& shard_of(const K& key) const
+    {
+      // Use the upper bits, the lower ones select the buckets within the shard
+      const std::uint64_t hash = std::uint64_t{Hash{}(key)} * 0x9e3779b97f4a7c15ull;
+
+      return _shards[(hash >> 32) % _shard_count];
+    }
+
+    [[nodiscard]] static const std::optional<V>* find(shard& s, const K& key)
+    {
+      const auto it = s._index.find(key);
+
+      if (it == s._index.end())
+        return nullptr;
+
+      slot& entry = s._slots[it->second];
+      entry._referenced = true;
+
+      return &entry._value;
+    }
+
+    void insert(shard& s, const K& key, const V& value)
+    {
+      std::size_t index = s._slots.size();
+
+      if (const auto it = s._index.find(key); it != s._index.end())
+      {
+        index = it->second;
+      }
+      else if (index < s._capacity)
+      {
+        s._slots.emplace_back();
+      }
+      else
+      {
+        for (;; s._hand = (s._hand + 1) % s._slots.size())
+        {
+          slot& victim = s._slots[s._hand];
+
+          if (!victim._key || !std::exchange(victim._referenced, false))
+            break;
+        }
+
+        index = std::exchange(s._hand, (s._hand + 1) % s._slots.size());
+
+        if (s._slots[index]._key)
+          s._index.erase(*s._slots[index]._key);
+      }
+
+      slot& entry = s._slots[index];
+      entry._key = key;
+      entry._value = value;
+      entry._referenced = false;
+
+      s._index[key] = index;
+    }
+
+    template <typename Arg>
+    void fill(const K& key, Arg&& arg)
+    {
+      shard& s = shard_of(key);
+      detail::future_value<V> value(std::forward<Arg>(arg));
+      std::optional<detail::async_waiter_queue<V>> waiters;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(s._mutex);
+#endif
+
+        const auto it = s._pending.find(key);
+
+        waiters.emplace(std::move(it->second));
+        s._pending.erase(it);
+
+        if (value.index() == 1)
+          insert(s, key, std::get<1>(value));
+      }
+
+      while (!waiters->empty())
+      {
+        std::shared_ptr<detail::async_waiter<V>> waiter = waiters->pop();
+
+        if (waiters->empty())
+          detail::async_waiter_queue<V>::satisfy_waiter(std::move(waiter), std::move(value));
+        else
+          detail::async_waiter_queue<V>::satisfy_waiter(std::move(waiter), value);
+      }
+    }
+  };
+
+} // namespace yolo
+
+#endif
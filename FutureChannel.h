@@ -0,0 +1,288 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_CHANNEL_H
+#define YOLO_FUTURE_CHANNEL_H
+
+#include "FutureSync.h"
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace yolo
+{
+  namespace detail
+  {
+    template <typename T>
+    struct channel_sender : async_waiter<void>
+    {
+      using async_waiter<void>::async_waiter;
+
+      std::optional<T> _value;
+    };
+
+  } // namespace detail
+
+  /*
+   * Bounded channel passing a stream of values between producers and consumers
+   *
+   * The future returned by send() completes once the value is buffered or handed to a receiver, so a
+   * full channel applies backpressure to producers. receive() yields std::nullopt after the channel is
+   * closed and drained. Values move through a fixed ring buffer, while it has data or room try_send()
+   * and try_receive() don't allocate. Pending senders fail when the channel is closed.
+   */
+  template <typename T>
+  class channel
+  {
+    static_assert(detail::is_valid_future_value_v<T>, "T must not be any of the types used internally.");
+
+  public:
+    explicit channel(std::size_t capacity)
+      : _buffer(capacity)
+    {
+    }
+
+    channel(const channel& that) = delete;
+    channel& operator=(const channel& that) = delete;
+
+    [[nodiscard]] future<void> send(T value, detail::future_site site = detail::future_site::current())
+    {
+      std::shared_ptr<detail::async_waiter<std::optional<T>>> receiver;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (_closed)
+          return make_exceptional_future<void>(detail::make_future_error("channel closed"));
+
+        if (!_receivers.empty())
+        {
+          receiver = _receivers.pop();
+        }
+        else if (_size < _buffer.size())
+        {
+          push(std::move(value));
+        }
+        else
+        {
+          auto sender = std::make_shared<detail::channel_sender<T>>(site);
+          sender->_value.emplace(std::move(value));
+
+          _senders.push(sender);
+
+          return detail::make_waiter_future<void>(sender);
+        }
+      }
+
+      if (receiver)
+        satisfy(std::move(receiver), std::optional<T>(std::move(value)));
+
+      return detail::future_helper::make_ready<void>(detail::future_void{});
+    }
+
+    [[nodiscard]] bool try_send(T&& value)
+    {
+      std::shared_ptr<detail::async_waiter<std::optional<T>>> receiver;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (_closed)
+          return false;
+
+        if (!_receivers.empty())
+          receiver = _receivers.pop();
+        else if (_size < _buffer.size())
+          push(std::move(value));
+        else
+          return false;
+      }
+
+      if (receiver)
+        satisfy(std::move(receiver), std::optional<T>(std::move(value)));
+
+      return true;
+    }
+
+    [[nodiscard]] future<std::optional<T>> receive(detail::future_site site = detail::future_site::current())
+    {
+      std::optional<T> value;
+      std::shared_ptr<detail::async_waiter<void>> sender;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (!take(value, sender))
+        {
+          if (!_closed)
+          {
+            auto receiver = std::make_shared<detail::async_waiter<std::optional<T>>>(site);
+
+            _receivers.push(receiver);
+
+            return detail::make_waiter_future(receiver);
+          }
+        }
+      }
+
+      if (sender)
+        satisfy(std::move(sender), detail::future_void{});
+
+      return make_ready_future(std::move(value));
+    }
+
+    [[nodiscard]] std::optional<T> try_receive()
+    {
+      std::optional<T> value;
+      std::shared_ptr<detail::async_waiter<void>> sender;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        take(value, sender);
+      }
+
+      if (sender)
+        satisfy(std::move(sender), detail::future_void{});
+
+      return value;
+    }
+
+    /*
+     * Pending receivers get std::nullopt, pending senders fail and buffered values remain receivable
+     */
+    void close()
+    {
+      std::optional<detail::async_waiter_queue<std::optional<T>>> receivers;
+      std::optional<detail::async_waiter_queue<void>> senders;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (std::exchange(_closed, true))
+          return;
+
+        receivers.emplace(std::move(_receivers));
+        senders.emplace(std::move(_senders));
+      }
+
+      while (!receivers->empty())
+        satisfy(receivers->pop(), std::optional<T>{});
+
+      while (!senders->empty())
+        satisfy(senders->pop(), detail::make_future_error("channel closed"));
+    }
+
+    [[nodiscard]] bool closed() const
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      return _closed;
+    }
+
+    [[nodiscard]] std::size_t size() const
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      return _size;
+    }
+
+    [[nodiscard]] std::size_t capacity() const noexcept
+    {
+      return _buffer.size();
+    }
+
+  private:
+#if !defined(YOLO_SINGLE_THREADED)
+    mutable std::mutex _mutex;
+#endif
+
+    std::vector<std::optional<T>> _buffer;
+    std::size_t _head = 0;
+    std::size_t _size = 0;
+    bool _closed = false;
+    detail::async_waiter_queue<void> _senders;
+    detail::async_waiter_queue<std::optional<T>> _receivers;
+
+    template <typename U, typename Arg>
+    static void satisfy(std::shared_ptr<detail::async_waiter<U>>&& waiter, Arg&& arg)
+    {
+      detail::async_waiter_queue<U>::satisfy_waiter(std::move(waiter), std::forward<Arg>(arg));
+    }
+
+    void push(T&& value)
+    {
+      _buffer[(_head + _size) % _buffer.size()].emplace(std::move(value));
+
+      ++_size;
+    }
+
+    /*
+     * Takes the oldest value and refills the buffer from the first pending sender
+     */
+    bool take(std::optional<T>& value, std::shared_ptr<detail::async_waiter<void>>& sender)
+    {
+      if (_size != 0)
+      {
+        value = std::move(_buffer[_head]);
+        _buffer[_head].reset();
+        _head = (_head + 1) % _buffer.size();
+
+        --_size;
+      }
+
+      if (!_senders.empty())
+      {
+        sender = _senders.pop();
+
+        auto& pending = static_cast<detail::channel_sender<T>&>(*sender)._value;
+
+        if (value)
+          push(std::move(*pending));
+        else
+          value = std::move(pending);
+
+        pending.reset();
+      }
+
+      return value.has_value();
+    }
+  };
+
+} // namespace yolo
+
+#endif
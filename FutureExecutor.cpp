@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "FutureExecutor.h"
+
+namespace yolo
+{
+#if !defined(YOLO_SINGLE_THREADED)
+  thread_pool::thread_pool(std::size_t threads)
+  {
+    _threads.reserve(std::max<std::size_t>(threads, 1));
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i)
+      _threads.emplace_back([this]() { run(); });
+  }
+
+  thread_pool::~thread_pool()
+  {
+    {
+      const std::lock_guard lock(_mutex);
+
+      _stopped = true;
+    }
+
+    _wakeup.notify_all();
+
+    for (std::thread& thread : _threads)
+      thread.join();
+  }
+
+  void thread_pool::post(std::function<void()> task)
+  {
+    {
+      const std::lock_guard lock(_mutex);
+
+      _tasks.push_back(std::move(task));
+    }
+
+    _wakeup.notify_one();
+  }
+
+  void thread_pool::run()
+  {
+    std::unique_lock lock(_mutex);
+
+    for (;;)
+    {
+      _wakeup.wait(lock, [this]() { return _stopped || !_tasks.empty(); });
+
+      if (_tasks.empty())
+        return;
+
+      std::function<void()> task = std::move(_tasks.front());
+      _tasks.pop_front();
+
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+#endif
+
+  void priority_executor::post(priority prio, detail::executor_task_ptr task)
+  {
+    task->_posted = std::chrono::steady_clock::now();
+
+#if !defined(YOLO_SINGLE_THREADED)
+    const std::lock_guard lock(_mutex);
+#endif
+
+    lane& queue = _lanes[static_cast<std::size_t>(prio)];
+    detail::executor_task* node = task.release();
+
+    (queue._tail ? queue._tail->_next : queue._head) = node;
+    queue._tail = node;
+
+    queue._stats.max_depth = std::max(++queue._stats.depth, queue._stats.max_depth);
+  }
+
+  bool priority_executor::run_one()
+  {
+    detail::executor_task_ptr task;
+
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      lane* next = nullptr;
+
+      for (lane& queue : _lanes)
+      {
+        if (!queue._head)
+          continue;
+
+        if (!next)
+          next = &queue;
+        else if (++queue._skipped > _starvation_limit)
+          next = &queue;
+      }
+
+      if (!next)
+        return false;
+
+      next->_skipped = 0;
+
+      task.reset(std::exchange(next->_head, next->_head->_next));
+
+      if (!next->_head)
+        next->_tail = nullptr;
+
+      const auto wait = std::chrono::steady_clock::now() - task->_posted;
+
+      --next->_stats.depth;
+      ++next->_stats.executed;
+      next->_stats.total_wait += wait;
+      next->_stats.max_wait = std::max<std::chrono::nanoseconds>(next->_stats.max_wait, wait);
+    }
+
+    task->run();
+
+    return true;
+  }
+
+  std::size_t priority_executor::run()
+  {
+    std::size_t count = 0;
+
+    while (run_one())
+      ++count;
+
+    return count;
+  }
+
+  priority_executor::lane_stats priority_executor::stats(priority prio) const
+  {
+#if !defined(YOLO_SINGLE_THREADED)
+    const std::lock_guard lock(_mutex);
+#endif
+
+    return _lanes[static_cast<std::size_t>(prio)]._stats;
+  }
+
+} // namespace yolo
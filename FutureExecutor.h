@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_EXECUTOR_H
+#define YOLO_FUTURE_EXECUTOR_H
+
+#include "Future.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#if !defined(YOLO_SINGLE_THREADED)
+#include <condition_variable>
+#include <thread>
+#endif
+
+namespace yolo
+{
+  /*
+   * Executors are objects with a post() member accepting a copyable function object without arguments
+   */
+  struct inline_executor
+  {
+    template <typename Func>
+    void post(Func&& func)
+    {
+      std::invoke(std::forward<Func>(func));
+    }
+  };
+
+#if !defined(YOLO_SINGLE_THREADED)
+  class thread_pool
+  {
+  public:
+    explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency());
+
+    thread_pool(const thread_pool& that) = delete;
+    thread_pool& operator=(const thread_pool& that) = delete;
+
+    /*
+     * Runs all queued tasks before joining the threads
+     */
+    ~thread_pool();
+
+    void post(std::function<void()> task);
+
+  private:
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread> _threads;
+    bool _stopped = false;
+
+    void run();
+  };
+#endif
+
+  /*
+   * Executor serving one queue per priority, drained by threads calling run_one() or run()
+   *
+   * The highest priority lane with work is served first. A lane which was passed over starvation_limit
+   * times while it had work is served next regardless of its priority.
+   */
+  class priority_executor
+  {
+  public:
+    static constexpr std::size_t lane_count = 3;
+
+    struct lane_stats
+    {
+      std::size_t depth = 0;
+      std::size_t max_depth = 0;
+      std::uint64_t executed = 0;
+      std::chrono::nanoseconds total_wait{0};
+      std::chrono::nanoseconds max_wait{0};
+    };
+
+    explicit priority_executor(std::size_t starvation_limit = 16)
+      : _starvation_limit(starvation_limit)
+    {
+    }
+
+    priority_executor(const priority_executor& that) = delete;
+    priority_executor& operator=(const priority_executor& that) = delete;
+
+    /*
+     * Runs all queued tasks
+     */
+    ~priority_executor()
+    {
+      run();
+    }
+
+    void post(priority prio, detail::executor_task_ptr task);
+
+    template <typename Func>
+    void post(priority prio, Func&& func)
+    {
+      post(
+        prio,
+        detail::executor_task_ptr(
+          std::make_unique<detail::executor_function<std::decay_t<Func>>>(std::forward<Func>(func))));
+    }
+
+    template <typename Func>
+    void post(Func&& func)
+    {
+      post(priority::normal, std::forward<Func>(func));
+    }
+
+    /*
+     * Runs the next task if there is one
+     */
+    bool run_one();
+
+    std::size_t run();
+
+    [[nodiscard]] lane_stats stats(priority prio) const;
+
+  private:
+    struct lane
+    {
+      detail::executor_task* _head = nullptr;
+      detail::executor_task* _tail = nullptr;
+      std::size_t _skipped = 0;
+      lane_stats _stats;
+    };
+
+#if !defined(YOLO_SINGLE_THREADED)
+    mutable std::mutex _mutex;
+#endif
+
+    std::size_t _starvation_limit;
+    std::array<lane, lane_count> _lanes;
+  };
+
+} // namespace yolo
+
+#endif
@@ -0,0 +1,240 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "FutureIo.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace yolo
+{
+#if defined(__linux__)
+  bool detail::io_operation::perform(int fd) noexcept
+  {
+    for (;;)
+    {
+      long result = -1;
+
+      switch (_kind)
+      {
+      case kind::read:
+        result = ::read(fd, _data, _size);
+        break;
+      case kind::write:
+        result = ::send(fd, _data, _size, MSG_NOSIGNAL);
+        if ((result < 0) && (errno == ENOTSOCK))
+          result = ::write(fd, _data, _size);
+        break;
+      case kind::accept:
+        result = ::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        break;
+      }
+
+      if (result >= 0)
+      {
+        _result = static_cast<std::size_t>(result);
+        return true;
+      }
+
+      if (errno == EINTR)
+        continue;
+
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        return false;
+
+      _error = errno;
+      return true;
+    }
+  }
+
+  void detail::io_operation::complete()
+  {
+    if (auto* prm = std::get_if<promise<int>>(&_promise))
+    {
+      if (_error)
+        prm->set_exception(std::make_exception_ptr(std::system_error(_error, std::generic_category())));
+      else
+        prm->set_value(static_cast<int>(_result));
+    }
+    else
+    {
+      auto& transfer = std::get<promise<std::size_t>>(_promise);
+
+      if (_error)
+        transfer.set_exception(std::make_exception_ptr(std::system_error(_error, std::generic_category())));
+      else
+        transfer.set_value(_result);
+    }
+  }
+
+  io_context::io_context()
+    : _epoll(::epoll_create1(EPOLL_CLOEXEC))
+  {
+    if (_epoll < 0)
+      throw std::system_error(errno, std::generic_category(), "epoll_create1");
+  }
+
+  io_context::~io_context()
+  {
+    ::close(_epoll);
+  }
+
+  void io_context::cancel(int fd)
+  {
+    std::vector<detail::io_operation> cancelled;
+
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      const auto it = _descriptors.find(fd);
+
+      if (it == _descriptors.end())
+        return;
+
+      for (auto& queue : it->second)
+      {
+        for (detail::io_operation& op : queue)
+        {
+          op._error = ECANCELED;
+          cancelled.push_back(std::move(op));
+        }
+      }
+
+      _pending -= cancelled.size();
+      _descriptors.erase(it);
+
+      ::epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    for (detail::io_operation& op : cancelled)
+      op.complete();
+  }
+
+  std::size_t io_context::pending() const
+  {
+#if !defined(YOLO_SINGLE_THREADED)
+    const std::lock_guard lock(_mutex);
+#endif
+
+    return _pending;
+  }
+
+  std::size_t io_context::run_once(int timeout)
+  {
+    std::array<epoll_event, 64> events;
+    std::vector<detail::io_operation> completed;
+
+    const int count = ::epoll_wait(_epoll, events.data(), static_cast<int>(events.size()), timeout);
+
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        return 0;
+
+      throw std::system_error(errno, std::generic_category(), "epoll_wait");
+    }
+
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      for (int i = 0; i < count; ++i)
+      {
+        const auto it = _descriptors.find(events[i].data.fd);
+
+        if (it == _descriptors.end())
+          continue;
+
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+          drain(events[i].data.fd, it->second[0]);
+
+        if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+          drain(events[i].data.fd, it->second[1]);
+      }
+
+      // Continuations may run the reactor again, so they must not see this batch
+      completed.swap(_completed);
+
+      _pending -= completed.size();
+    }
+
+    for (detail::io_operation& op : completed)
+      op.complete();
+
+    return completed.size();
+  }
+
+  std::size_t io_context::run()
+  {
+    std::size_t completed = 0;
+
+    while (pending() != 0)
+      completed += run_once();
+
+    return completed;
+  }
+
+  std::array<io_context::queue_type, 2>& io_context::descriptor(int fd)
+  {
+    const auto [it, inserted] = _descriptors.try_emplace(fd);
+
+    if (inserted)
+    {
+      epoll_event event{};
+      event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+      event.data.fd = fd;
+
+      const int flags = ::fcntl(fd, F_GETFL);
+
+      if ((flags < 0) || (::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) ||
+          (::epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) < 0))
+      {
+        const int error = errno;
+
+        _descriptors.erase(it);
+
+        throw std::system_error(error, std::generic_category(), "epoll_ctl");
+      }
+    }
+
+    return it->second;
+  }
+
+  void io_context::drain(int fd, queue_type& queue)
+  {
+    while (!queue.empty() && queue.front().perform(fd))
+    {
+      _completed.push_back(std::move(queue.front()));
+      queue.pop_front();
+    }
+  }
+#endif
+
+} // namespace yolo
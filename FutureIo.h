@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_IO_H
+#define YOLO_FUTURE_IO_H
+
+#include "Future.h"
+
+#include <array>
+#include <deque>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace yolo
+{
+#if defined(__linux__)
+  namespace detail
+  {
+    struct io_operation
+    {
+      enum class kind
+      {
+        read,
+        write,
+        accept
+      };
+
+      kind _kind = kind::read;
+      void* _data = nullptr;
+      std::size_t _size = 0;
+      std::size_t _result = 0;
+      int _error = 0;
+      std::variant<promise<std::size_t>, promise<int>> _promise;
+
+      /*
+       * Returns false if the operation would block, otherwise either _result or _error is set
+       */
+      [[nodiscard]] bool perform(int fd) noexcept;
+
+      void complete();
+    };
+
+  } // namespace detail
+
+  /*
+   * Reactor completing futures for I/O on non-blocking file descriptors with edge triggered epoll
+   *
+   * An operation is attempted right away if no other operation of the same direction is queued for the
+   * descriptor, in which case a ready future is returned. Otherwise it is queued and completed by
+   * run_once(), which performs the I/O for a whole batch of epoll events before satisfying any promise.
+   * Reads and writes transfer at most size bytes directly from or into the caller owned buffer, which
+   * has to stay valid until the future is satisfied. Descriptors are switched to non-blocking mode on
+   * first use and have to be released with cancel() before they are closed.
+   */
+  class io_context
+  {
+  public:
+    io_context();
+
+    io_context(const io_context& that) = delete;
+    io_context& operator=(const io_context& that) = delete;
+
+    ~io_context();
+
+    [[nodiscard]] future<std::size_t> async_read(int fd, void* data, std::size_t size)
+    {
+      return submit<std::size_t>(fd, detail::io_operation::kind::read, data, size);
+    }
+
+    [[nodiscard]] future<std::size_t> async_write(int fd, const void* data, std::size_t size)
+    {
+      return submit<std::size_t>(fd, detail::io_operation::kind::write, const_cast<void*>(data), size);
+    }
+
+    [[nodiscard]] future<int> async_accept(int fd)
+    {
+      return submit<int>(fd, detail::io_operation::kind::accept, nullptr, 0);
+    }
+
+    /*
+     * Fails all queued operations of fd with ECANCELED and removes fd from the reactor
+     */
+    void cancel(int fd);
+
+    [[nodiscard]] std::size_t pending() const;
+
+    /*
+     * Waits up to timeout milliseconds for events, -1 blocks, and returns the number of completions.
+     * Only one thread may run the reactor at a time, continuations may run it again.
+     */
+    std::size_t run_once(int timeout = -1);
+
+    std::size_t poll()
+    {
+      return run_once(0);
+    }
+
+    /*
+     * Runs the reactor until no operations are pending
+     */
+    std::size_t run();
+
+  private:
+    using queue_type = std::deque<detail::io_operation>;
+
+#if !defined(YOLO_SINGLE_THREADED)
+    mutable std::mutex _mutex;
+#endif
+
+    int _epoll;
+    std::size_t _pending = 0;
+    std::unordered_map<int, std::array<queue_type, 2>> _descriptors;
+    std::vector<detail::io_operation> _completed;
+
+    template <typename T>
+    [[nodiscard]] future<T> submit(int fd, detail::io_operation::kind kind, void* data, std::size_t size)
+    {
+      detail::io_operation op;
+      op._kind = kind;
+      op._data = data;
+      op._size = size;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        queue_type& queue = descriptor(fd)[(kind == detail::io_operation::kind::write) ? 1 : 0];
+
+        if (!queue.empty() || !op.perform(fd))
+        {
+          auto [prm, fut] = make_promise<T>();
+
+          op._promise = std::move(prm);
+          queue.push_back(std::move(op));
+
+          ++_pending;
+
+          return std::move(fut);
+        }
+      }
+
+      if (op._error)
+        return make_exceptional_future<T>(
+          std::make_exception_ptr(std::system_error(op._error, std::generic_category())));
+
+      return detail::future_helper::make_ready<T>(static_cast<T>(op._result));
+    }
+
+    [[nodiscard]] std::array<queue_type, 2>& descriptor(int fd);
+
+    void drain(int fd, queue_type& queue);
+  };
+#endif
+
+} // namespace yolo
+
+#endif
@@ -0,0 +1,253 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "FutureShm.h"
+
+#if defined(__linux__)
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace yolo
+{
+#if defined(__linux__)
+  namespace
+  {
+    void futex_wake(std::uint32_t* futex) noexcept
+    {
+      ::syscall(SYS_futex, futex, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    /*
+     * Guards the free lists of a segment against all processes sharing it, only held for a few loads
+     * and stores
+     */
+    class shm_lock
+    {
+    public:
+      explicit shm_lock(detail::shm_header& header) noexcept
+        : _header(header)
+      {
+        while (_header._lock.exchange(1, std::memory_order_acquire) != 0)
+          ::sched_yield();
+      }
+
+      shm_lock(const shm_lock& that) = delete;
+      shm_lock& operator=(const shm_lock& that) = delete;
+
+      ~shm_lock()
+      {
+        _header._lock.store(0, std::memory_order_release);
+      }
+
+    private:
+      detail::shm_header& _header;
+    };
+
+    [[nodiscard]] std::size_t shm_size_class(std::size_t size) noexcept
+    {
+      std::size_t index = 0;
+
+      while ((detail::shm_header::min_slot << index) < size)
+        ++index;
+
+      return index;
+    }
+
+  } // namespace
+
+  bool detail::shm_status::claim(std::uint32_t generation)
+  {
+    std::uint32_t status = _status.load(std::memory_order_relaxed);
+
+    do
+    {
+      if (!current(status, generation))
+        return false;
+
+      if ((status & state_mask) != empty)
+        throw_future_error("promise already satisfied");
+    } while (!_status.compare_exchange_weak(
+      status, (status & ~state_mask) | writing, std::memory_order_acquire, std::memory_order_relaxed));
+
+    return true;
+  }
+
+  void detail::shm_status::publish(std::uint32_t generation, std::uint32_t state) noexcept
+  {
+    if (_status.exchange((generation << generation_shift) | state, std::memory_order_release) & waiting)
+      futex_wake(futex());
+  }
+
+  bool detail::shm_status::wait(std::uint32_t generation, std::chrono::nanoseconds timeout) noexcept
+  {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    for (;;)
+    {
+      std::uint32_t status = _status.load(std::memory_order_acquire);
+
+      if (!current(status, generation) || ((status & state_mask) >= value))
+        return true;
+
+      if (!(status & waiting) &&
+          !_status.compare_exchange_weak(status, status | waiting, std::memory_order_relaxed))
+        continue;
+
+      timespec relative{};
+      timespec* wait_time = nullptr;
+
+      if (timeout >= std::chrono::nanoseconds::zero())
+      {
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+
+        if (remaining <= std::chrono::nanoseconds::zero())
+          return false;
+
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+
+        relative.tv_sec = static_cast<time_t>(ns / 1000000000);
+        relative.tv_nsec = static_cast<long>(ns % 1000000000);
+        wait_time = &relative;
+      }
+
+      ::syscall(SYS_futex, futex(), FUTEX_WAIT, status | waiting, wait_time, nullptr, 0);
+    }
+  }
+
+  bool detail::shm_status::release(std::uint32_t generation) noexcept
+  {
+    const std::uint32_t next = ((generation + 1) & generation_mask) << generation_shift;
+    std::uint32_t status = _status.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+      if (!current(status, generation))
+        return false;
+
+      // A promise of another process is copying its value, which only takes a moment
+      if ((status & state_mask) == writing)
+      {
+        ::sched_yield();
+
+        status = _status.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (_status.compare_exchange_weak(status, next, std::memory_order_acq_rel, std::memory_order_relaxed))
+        break;
+    }
+
+    if (status & waiting)
+      futex_wake(futex());
+
+    return true;
+  }
+
+  int detail::shm_process() noexcept
+  {
+    return ::getpid();
+  }
+
+  shm_segment::shm_segment(std::size_t size)
+  {
+    constexpr std::size_t max_size = std::size_t{0xffffffff} & ~(detail::shm_header::min_slot - 1);
+
+    size = std::clamp(size, detail::shm_header::min_slot, max_size) & ~(detail::shm_header::min_slot - 1);
+
+    void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED)
+      throw std::system_error(errno, std::generic_category(), "mmap");
+
+    _header = new (memory) detail::shm_header();
+    _header->_size = static_cast<std::uint32_t>(size);
+  }
+
+  shm_segment::~shm_segment()
+  {
+    ::munmap(_header, _header->_size);
+  }
+
+  shm_handle shm_segment::allocate(std::size_t size)
+  {
+    const std::size_t index = shm_size_class(size);
+    const auto slot_size = static_cast<std::uint32_t>(detail::shm_header::min_slot << index);
+
+    std::uint32_t offset = 0;
+
+    {
+      const shm_lock lock(*_header);
+
+      if (_header->_free[index] != 0)
+      {
+        offset = _header->_free[index];
+        _header->_free[index] = status(offset)._next_free;
+      }
+      else if (slot_size <= _header->_size - _header->_used)
+      {
+        offset = _header->_used;
+        _header->_used += slot_size;
+
+        new (slot(offset)) detail::shm_status();
+      }
+    }
+
+    if (offset == 0)
+      throw std::bad_alloc();
+
+    shm_handle handle;
+    handle.offset = offset;
+    handle.generation = status(offset)._status.load(std::memory_order_relaxed) >> detail::shm_status::generation_shift;
+
+    return handle;
+  }
+
+  void shm_segment::release(const shm_handle& handle, std::size_t size) noexcept
+  {
+    detail::shm_status& released = status(handle.offset);
+
+    if (!released.release(handle.generation))
+      return;
+
+    const std::size_t index = shm_size_class(size);
+    const shm_lock lock(*_header);
+
+    released._next_free = _header->_free[index];
+    _header->_free[index] = handle.offset;
+  }
+
+  void shm_segment::check(const shm_handle& handle) const
+  {
+    if ((handle.offset < detail::shm_header::min_slot) || (handle.offset % detail::shm_header::min_slot != 0) ||
+        (handle.offset >= _header->_size) || (handle.generation > detail::shm_status::generation_mask))
+      detail::throw_future_error("invalid handle");
+  }
+#endif
+
+} // namespace yolo
@@ -0,0 +1,412 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_SHM_H
+#define YOLO_FUTURE_SHM_H
+
+#include "Future.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+
+namespace yolo
+{
+#if defined(__linux__)
+  /*
+   * Identifies a promise in a shm_segment, it can be passed to other processes sharing the segment
+   */
+  struct shm_handle
+  {
+    std::uint32_t offset = 0;
+    std::uint32_t generation = 0;
+  };
+
+  namespace detail
+  {
+    /*
+     * Status of a cross process promise, the status word is used as futex. Its upper bits count how
+     * often the slot was reused, so handles of an earlier use can't touch the current one.
+     */
+    struct shm_status
+    {
+      static constexpr std::uint32_t empty = 0;
+      static constexpr std::uint32_t writing = 1;
+      static constexpr std::uint32_t value = 2;
+      static constexpr std::uint32_t error = 3;
+      static constexpr std::uint32_t state_mask = 3;
+      static constexpr std::uint32_t waiting = 4;
+      static constexpr std::uint32_t generation_shift = 3;
+      static constexpr std::uint32_t generation_mask = ~std::uint32_t{0} >> generation_shift;
+
+      static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "Futexes require lock free atomics.");
+      static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "Futexes are 32 bit words.");
+
+      std::atomic<std::uint32_t> _status{empty};
+      int _error = 0;
+      // Offset of the next free slot of the same size while released
+      std::uint32_t _next_free = 0;
+
+      [[nodiscard]] std::uint32_t* futex() noexcept
+      {
+        return reinterpret_cast<std::uint32_t*>(&_status);
+      }
+
+      [[nodiscard]] static bool current(std::uint32_t status, std::uint32_t generation) noexcept
+      {
+        return (status >> generation_shift) == generation;
+      }
+
+      /*
+       * Returns false if the slot was released, nobody can read the value anymore
+       */
+      [[nodiscard]] bool claim(std::uint32_t generation);
+
+      void publish(std::uint32_t generation, std::uint32_t state) noexcept;
+
+      /*
+       * Returns false on timeout, a negative timeout waits forever. Returns true once the slot was released.
+       */
+      [[nodiscard]] bool wait(std::uint32_t generation, std::chrono::nanoseconds timeout) noexcept;
+
+      /*
+       * Starts the next generation of the slot, returns false if that already happened
+       */
+      [[nodiscard]] bool release(std::uint32_t generation) noexcept;
+    };
+
+    /*
+     * Start of a segment, slots are multiples of min_slot bytes and kept in one free list per size
+     */
+    struct shm_header
+    {
+      static constexpr std::size_t min_slot = 64;
+      static constexpr std::size_t size_classes = 7;
+      static constexpr std::size_t max_slot = min_slot << (size_classes - 1);
+
+      std::atomic<std::uint32_t> _lock{0};
+      std::uint32_t _size = 0;
+      std::uint32_t _used = min_slot;
+      std::uint32_t _free[size_classes] = {};
+    };
+
+    static_assert(sizeof(shm_header) <= shm_header::min_slot, "The header must fit into the first slot.");
+
+    template <typename T>
+    inline constexpr std::size_t shm_value_offset = (sizeof(shm_status) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    template <typename T>
+    inline constexpr std::size_t shm_slot_size = shm_value_offset<T> + sizeof(T);
+
+    [[nodiscard]] int shm_process() noexcept;
+
+  } // namespace detail
+
+  template <typename T>
+  class shm_promise;
+
+  template <typename T>
+  class shm_future;
+
+  /*
+   * Anonymous shared mapping holding the states of cross process promises
+   *
+   * Every process forked after the segment was created shares it and can make promises from it at
+   * any time. Pass the handle of a promise or future to another process, through a pipe for example,
+   * and attach it there. A slot is recycled once the future owning it is destroyed. The segment has
+   * to outlive all promises and futures of the process.
+   */
+  class shm_segment
+  {
+  public:
+    /*
+     * Maps size bytes, at most 4 GiB
+     */
+    explicit shm_segment(std::size_t size = std::size_t{1} << 20);
+
+    shm_segment(const shm_segment& that) = delete;
+    shm_segment& operator=(const shm_segment& that) = delete;
+
+    ~shm_segment();
+
+    template <typename T>
+    [[nodiscard]] std::pair<shm_promise<T>, shm_future<T>> make_promise()
+    {
+      const shm_handle handle = allocate(detail::shm_slot_size<T>);
+
+      return {shm_promise<T>(*this, handle), shm_future<T>(*this, handle)};
+    }
+
+    /*
+     * The promise may be attached in any number of processes, only one of them can satisfy it
+     */
+    template <typename T>
+    [[nodiscard]] shm_promise<T> attach_promise(const shm_handle& handle)
+    {
+      check(handle);
+
+      return shm_promise<T>(*this, handle);
+    }
+
+    /*
+     * Takes over a handle returned by shm_future::detach()
+     */
+    template <typename T>
+    [[nodiscard]] shm_future<T> attach_future(const shm_handle& handle)
+    {
+      check(handle);
+
+      return shm_future<T>(*this, handle);
+    }
+
+  private:
+    template <typename T>
+    friend class shm_promise;
+
+    template <typename T>
+    friend class shm_future;
+
+    detail::shm_header* _header;
+
+    [[nodiscard]] shm_handle allocate(std::size_t size);
+
+    void release(const shm_handle& handle, std::size_t size) noexcept;
+
+    void check(const shm_handle& handle) const;
+
+    [[nodiscard]] unsigned char* slot(std::uint32_t offset) const noexcept
+    {
+      return reinterpret_cast<unsigned char*>(_header) + offset;
+    }
+
+    [[nodiscard]] detail::shm_status& status(std::uint32_t offset) const noexcept
+    {
+      return *reinterpret_cast<detail::shm_status*>(slot(offset));
+    }
+  };
+
+  /*
+   * Promise whose state lives in a shm_segment
+   *
+   * Satisfying it and reading a ready value are plain atomic operations, only waking a blocked reader
+   * and blocking take a futex system call. Destroying an unsatisfied promise does not break it, another
+   * process may still hold it. Satisfying a promise whose future is gone does nothing.
+   */
+  template <typename T>
+  class shm_promise
+  {
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable.");
+    static_assert(std::is_default_constructible_v<T>, "T must be default constructible.");
+    static_assert(detail::shm_slot_size<T> <= detail::shm_header::max_slot, "T must fit into a segment slot.");
+
+  public:
+    shm_promise() = default;
+
+    [[nodiscard]] shm_handle handle() const noexcept
+    {
+      return _handle;
+    }
+
+    void set_value(const T& value)
+    {
+      detail::shm_status& status = check();
+
+      if (!status.claim(_handle.generation))
+        return;
+
+      std::memcpy(_segment->slot(_handle.offset) + detail::shm_value_offset<T>, &value, sizeof(T));
+
+      status.publish(_handle.generation, detail::shm_status::value);
+    }
+
+    /*
+     * The reader gets a std::system_error with the error code
+     */
+    void set_error(int error)
+    {
+      detail::shm_status& status = check();
+
+      if (!status.claim(_handle.generation))
+        return;
+
+      status._error = error;
+      status.publish(_handle.generation, detail::shm_status::error);
+    }
+
+  private:
+    friend class shm_segment;
+
+    shm_segment* _segment = nullptr;
+    shm_handle _handle;
+
+    shm_promise(shm_segment& segment, const shm_handle& handle) noexcept
+      : _segment(&segment)
+      , _handle(handle)
+    {
+    }
+
+    [[nodiscard]] detail::shm_status& check() const
+    {
+      if (!_segment)
+        detail::throw_future_error("invalid promise");
+
+      return _segment->status(_handle.offset);
+    }
+  };
+
+  /*
+   * Reading side of a shm_promise, owned by the process which made or attached it
+   *
+   * Destroying the future in that process recycles the slot, copies inherited by fork() don't. The value
+   * can be read any number of times.
+   */
+  template <typename T>
+  class shm_future
+  {
+  public:
+    shm_future() = default;
+    shm_future(const shm_future& that) = delete;
+
+    shm_future(shm_future&& that) noexcept
+      : _segment(std::exchange(that._segment, nullptr))
+      , _handle(that._handle)
+      , _owner(that._owner)
+    {
+    }
+
+    shm_future& operator=(const shm_future& that) = delete;
+
+    shm_future& operator=(shm_future&& that) noexcept
+    {
+      if (this != &that)
+      {
+        reset();
+
+        _segment = std::exchange(that._segment, nullptr);
+        _handle = that._handle;
+        _owner = that._owner;
+      }
+
+      return *this;
+    }
+
+    ~shm_future()
+    {
+      reset();
+    }
+
+    [[nodiscard]] bool valid() const noexcept
+    {
+      return (_segment != nullptr);
+    }
+
+    [[nodiscard]] bool ready() const noexcept
+    {
+      if (!_segment)
+        return false;
+
+      const std::uint32_t status = _segment->status(_handle.offset)._status.load(std::memory_order_acquire);
+
+      return !detail::shm_status::current(status, _handle.generation) ||
+             ((status & detail::shm_status::state_mask) >= detail::shm_status::value);
+    }
+
+    /*
+     * Returns false if the promise wasn't satisfied in time
+     */
+    [[nodiscard]] bool wait_for(std::chrono::nanoseconds timeout) const
+    {
+      return check().wait(_handle.generation, std::max(timeout, std::chrono::nanoseconds::zero()));
+    }
+
+    /*
+     * Blocks until the promise is satisfied
+     */
+    [[nodiscard]] T get() const
+    {
+      detail::shm_status& status = check();
+
+      (void)status.wait(_handle.generation, std::chrono::nanoseconds{-1});
+
+      const std::uint32_t state = status._status.load(std::memory_order_acquire);
+
+      if (!detail::shm_status::current(state, _handle.generation))
+        detail::throw_future_error("broken promise");
+
+      if ((state & detail::shm_status::state_mask) == detail::shm_status::error)
+        throw std::system_error(status._error, std::generic_category());
+
+      T value;
+      std::memcpy(&value, _segment->slot(_handle.offset) + detail::shm_value_offset<T>, sizeof(T));
+
+      return value;
+    }
+
+    /*
+     * Gives up the ownership without recycling the slot, the process attaching the handle takes over
+     */
+    [[nodiscard]] shm_handle detach() noexcept
+    {
+      _segment = nullptr;
+
+      return _handle;
+    }
+
+  private:
+    friend class shm_segment;
+
+    shm_segment* _segment = nullptr;
+    shm_handle _handle;
+    int _owner = 0;
+
+    shm_future(shm_segment& segment, const shm_handle& handle) noexcept
+      : _segment(&segment)
+      , _handle(handle)
+      , _owner(detail::shm_process())
+    {
+    }
+
+    [[nodiscard]] detail::shm_status& check() const
+    {
+      if (!_segment)
+        detail::throw_future_error("invalid future");
+
+      return _segment->status(_handle.offset);
+    }
+
+    void reset() noexcept
+    {
+      if (_segment && (_owner == detail::shm_process()))
+        _segment->release(_handle, detail::shm_slot_size<T>);
+
+      _segment = nullptr;
+    }
+  };
+#endif
+
+} // namespace yolo
+
+#endif
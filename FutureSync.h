@@ -0,0 +1,404 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_SYNC_H
+#define YOLO_FUTURE_SYNC_H
+
+#include "Future.h"
+
+#include <memory>
+#include <optional>
+
+namespace yolo
+{
+  namespace detail
+  {
+    /*
+     * Future state which doubles as node of an intrusive waiter queue, the registry lists it with the
+     * call which started waiting
+     */
+    template <typename T>
+    struct async_waiter : future_state<T>
+    {
+      explicit async_waiter(future_site site)
+        : future_state<T>(future_origin{site})
+      {
+      }
+
+      std::shared_ptr<async_waiter> _next;
+      std::size_t _count = 0;
+    };
+
+    template <typename T>
+    struct async_waiter_queue
+    {
+      async_waiter_queue() = default;
+
+      async_waiter_queue(async_waiter_queue&& that) noexcept
+        : _head(std::move(that._head))
+        , _tail(std::exchange(that._tail, nullptr))
+      {
+      }
+
+      async_waiter_queue& operator=(async_waiter_queue&& that) = delete;
+
+      /*
+       * Breaks the promises of all remaining waiters without recursing along the list
+       */
+      ~async_waiter_queue()
+      {
+        while (!empty())
+          satisfy_waiter(pop(), make_future_error("broken promise"));
+      }
+
+      [[nodiscard]] bool empty() const noexcept
+      {
+        return !_head;
+      }
+
+      [[nodiscard]] async_waiter<T>& front() const noexcept
+      {
+        return *_head;
+      }
+
+      void push(std::shared_ptr<async_waiter<T>> waiter) noexcept
+      {
+        async_waiter<T>* tail = std::exchange(_tail, waiter.get());
+
+        (tail ? tail->_next : _head) = std::move(waiter);
+      }
+
+      [[nodiscard]] std::shared_ptr<async_waiter<T>> pop() noexcept
+      {
+        std::shared_ptr<async_waiter<T>> waiter = std::move(_head);
+
+        _head = std::move(waiter->_next);
+
+        if (!_head)
+          _tail = nullptr;
+
+        return waiter;
+      }
+
+      template <typename Arg>
+      static void satisfy_waiter(std::shared_ptr<async_waiter<T>>&& waiter, Arg&& arg)
+      {
+        waiter->set_value(std::forward<Arg>(arg));
+
+        future_next_ptr next = waiter->next();
+
+        execute_future({std::move(next), std::move(waiter)});
+      }
+
+    private:
+      std::shared_ptr<async_waiter<T>> _head;
+      async_waiter<T>* _tail = nullptr;
+    };
+
+    template <typename T>
+    [[nodiscard]] future<T> make_waiter_future(const std::shared_ptr<async_waiter<T>>& waiter)
+    {
+      future<T> fut;
+
+      future_helper::state(fut) = waiter;
+
+      return fut;
+    }
+
+  } // namespace detail
+
+  /*
+   * Semaphore handing out units as futures of guards
+   *
+   * Waiters are served in FIFO order. On release the units are handed directly to the waiters at the
+   * front of the queue, so only waiters which can actually proceed are woken.
+   */
+  class async_semaphore
+  {
+  public:
+    class guard
+    {
+    public:
+      guard() = default;
+      guard(const guard& that) = delete;
+
+      guard(guard&& that) noexcept
+        : _semaphore(std::exchange(that._semaphore, nullptr))
+        , _count(that._count)
+      {
+      }
+
+      guard& operator=(const guard& that) = delete;
+
+      guard& operator=(guard&& that) noexcept
+      {
+        if (this != &that)
+        {
+          release();
+
+          _semaphore = std::exchange(that._semaphore, nullptr);
+          _count = that._count;
+        }
+
+        return *this;
+      }
+
+      ~guard()
+      {
+        release();
+      }
+
+      [[nodiscard]] bool owns() const noexcept
+      {
+        return (_semaphore != nullptr);
+      }
+
+      void release()
+      {
+        if (_semaphore)
+          std::exchange(_semaphore, nullptr)->release(_count);
+      }
+
+    private:
+      friend async_semaphore;
+
+      async_semaphore* _semaphore = nullptr;
+      std::size_t _count = 0;
+
+      guard(async_semaphore& semaphore, std::size_t count) noexcept
+        : _semaphore(&semaphore)
+        , _count(count)
+      {
+      }
+    };
+
+    explicit async_semaphore(std::size_t count)
+      : _count(count)
+    {
+    }
+
+    async_semaphore(const async_semaphore& that) = delete;
+    async_semaphore& operator=(const async_semaphore& that) = delete;
+
+    [[nodiscard]] std::size_t available() const
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      return _count;
+    }
+
+    [[nodiscard]] future<guard> acquire(
+      std::size_t count = 1,
+      detail::future_site site = detail::future_site::current())
+    {
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (!_waiters.empty() || (count > _count))
+        {
+          auto waiter = std::make_shared<detail::async_waiter<guard>>(site);
+          waiter->_count = count;
+
+          _waiters.push(waiter);
+
+          return detail::make_waiter_future(waiter);
+        }
+
+        _count -= count;
+      }
+
+      return make_ready_future(guard(*this, count));
+    }
+
+    [[nodiscard]] std::optional<guard> try_acquire(std::size_t count = 1)
+    {
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (!_waiters.empty() || (count > _count))
+          return std::nullopt;
+
+        _count -= count;
+      }
+
+      return guard(*this, count);
+    }
+
+    /*
+     * Guards released by the continuations of woken waiters only return their units, the outermost
+     * release() hands them on. This keeps the stack flat however many waiters are queued.
+     */
+    void release(std::size_t count = 1)
+    {
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        _count += count;
+
+        if (std::exchange(_releasing, true))
+          return;
+      }
+
+      for (;;)
+      {
+        std::shared_ptr<detail::async_waiter<guard>> waiter;
+
+        {
+#if !defined(YOLO_SINGLE_THREADED)
+          const std::lock_guard lock(_mutex);
+#endif
+
+          if (_waiters.empty() || (_waiters.front()._count > _count))
+          {
+            _releasing = false;
+            return;
+          }
+
+          _count -= _waiters.front()._count;
+
+          waiter = _waiters.pop();
+        }
+
+        const std::size_t units = waiter->_count;
+
+        detail::async_waiter_queue<guard>::satisfy_waiter(std::move(waiter), guard(*this, units));
+      }
+    }
+
+  private:
+#if !defined(YOLO_SINGLE_THREADED)
+    mutable std::mutex _mutex;
+#endif
+
+    std::size_t _count;
+    bool _releasing = false;
+    detail::async_waiter_queue<guard> _waiters;
+  };
+
+  class async_mutex
+  {
+  public:
+    using guard = async_semaphore::guard;
+
+    async_mutex()
+      : _semaphore(1)
+    {
+    }
+
+    [[nodiscard]] future<guard> lock(detail::future_site site = detail::future_site::current())
+    {
+      return _semaphore.acquire(1, site);
+    }
+
+    [[nodiscard]] std::optional<guard> try_lock()
+    {
+      return _semaphore.try_acquire();
+    }
+
+  private:
+    async_semaphore _semaphore;
+  };
+
+  class async_latch
+  {
+  public:
+    explicit async_latch(std::size_t count)
+      : _count(count)
+    {
+    }
+
+    async_latch(const async_latch& that) = delete;
+    async_latch& operator=(const async_latch& that) = delete;
+
+    void count_down(std::size_t count = 1)
+    {
+      std::optional<detail::async_waiter_queue<void>> ready;
+
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        assert(count <= _count);
+
+        _count -= count;
+
+        if (_count == 0)
+          ready.emplace(std::move(_waiters));
+      }
+
+      if (ready)
+      {
+        while (!ready->empty())
+          detail::async_waiter_queue<void>::satisfy_waiter(ready->pop(), detail::future_void{});
+      }
+    }
+
+    [[nodiscard]] bool try_wait() const
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      return (_count == 0);
+    }
+
+    [[nodiscard]] future<void> wait(detail::future_site site = detail::future_site::current())
+    {
+      {
+#if !defined(YOLO_SINGLE_THREADED)
+        const std::lock_guard lock(_mutex);
+#endif
+
+        if (_count != 0)
+        {
+          auto waiter = std::make_shared<detail::async_waiter<void>>(site);
+
+          _waiters.push(waiter);
+
+          return detail::make_waiter_future(waiter);
+        }
+      }
+
+      return detail::future_helper::make_ready<void>(detail::future_void{});
+    }
+
+  private:
+#if !defined(YOLO_SINGLE_THREADED)
+    mutable std::mutex _mutex;
+#endif
+
+    std::size_t _count;
+    detail::async_waiter_queue<void> _waiters;
+  };
+
+} // namespace yolo
+
+#endif
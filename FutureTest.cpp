@@ -0,0 +1,1378 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Future.h"
+#include "FutureAlgorithm.h"
+#include "FutureArray.h"
+#include "FutureCache.h"
+#include "FutureChannel.h"
+#include "FutureExecutor.h"
+#include "FutureIo.h"
+#include "FutureShm.h"
+#include "FutureSync.h"
+#include "FutureTimer.h"
+
+#include <cassert>
+#include <string_view>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+int main()
+{
+  using namespace yolo;
+
+  struct test_exception
+  {
+  };
+
+  const auto throw_exception = []() -> long { throw test_exception{}; };
+
+  const auto exception_to_five = [](std::exception_ptr ex) {
+    try
+    {
+      std::rethrow_exception(std::move(ex));
+    }
+    catch (const test_exception&)
+    {
+      return 5;
+    }
+    catch (...)
+    {
+      return -1;
+    }
+  };
+
+  // Combinations of int and void
+  {
+    auto [prm, fut] = make_promise<int>();
+
+    assert(fut.valid() && !fut.ready());
+
+    prm.set_value(5);
+
+    assert(fut.valid() && fut.ready());
+
+    int result = -1;
+    fut.then([&result](int i) { result = i; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<int>();
+
+    assert(!fut.ready());
+
+    int result = -1;
+    fut.then([&result](int i) { result = i; });
+
+    assert(!fut.valid() && (result == -1));
+
+    prm.set_value(5);
+
+    assert(result == 5);
+  }
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    assert(fut.valid() && !fut.ready());
+
+    prm.set_value();
+
+    assert(fut.valid() && fut.ready());
+
+    int result = -1;
+    fut.then([&result]() { result = 5; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    assert(fut.valid() && !fut.ready());
+
+    prm.set_value();
+
+    assert(fut.valid() && fut.ready());
+
+    int result = -1;
+    fut.then([]() { return 5; }).then([&result](int i) { result = i; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    int result = -1;
+    fut.then([]() { return 5; }).then([](int i) { return 2 * i; }).then([&result](int i) { result = i; });
+
+    assert(!fut.valid() && (result == -1));
+
+    prm.set_value();
+
+    assert(result == 10);
+  }
+
+  // Error propagation
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    assert(fut.valid() && !fut.ready());
+
+    int result = 5;
+    fut.then([&result]() { result = -1; });
+
+    prm.set_exception(std::make_exception_ptr(test_exception{}));
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    assert(fut.valid() && !fut.ready());
+
+    prm.set_exception(std::make_exception_ptr(test_exception{}));
+
+    int result = 5;
+    fut.then([&result]() { result = -1; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<long>();
+
+    assert(fut.valid() && !fut.ready());
+
+    long result = -1;
+    fut.catch_exception(exception_to_five).then([&result](long l) { result = l; });
+
+    prm.set_exception(std::make_exception_ptr(test_exception{}));
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<long>();
+
+    assert(fut.valid() && !fut.ready());
+
+    long result = -1;
+    fut.catch_exception(exception_to_five).then([&result](long l) { result = l; });
+
+    prm.set_value(10);
+
+    assert(!fut.valid() && (result == 10));
+  }
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    assert(fut.valid() && !fut.ready());
+
+    int result = -1;
+    fut.catch_exception([=](std::exception_ptr) {}).then([&result]() { result = 5; });
+
+    prm.set_exception(std::make_exception_ptr(test_exception{}));
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    auto [prm, fut] = make_promise<void>();
+
+    bool called = false;
+    const auto skipped = [&called](long l) {
+      called = true;
+      return l;
+    };
+
+    int result = -1;
+    fut.then(throw_exception).then(skipped).catch_exception(exception_to_five).then([&result](long l) { result = l; });
+
+    prm.set_value();
+
+    assert(!fut.valid() && !called && (result == 5));
+  }
+
+  // Inner future
+  {
+    auto [prm0, fut0] = make_promise<int>();
+    auto [prm1, fut1] = make_promise<std::unique_ptr<int>>();
+
+    future<std::unique_ptr<long>> fut2 = fut0.then([fut = std::move(fut1)](int i) mutable {
+      return fut.then([i](std::unique_ptr<int> pi) { return std::make_unique<long>(i * (pi ? *pi : 0)); });
+    });
+
+    long result = -1;
+    fut2.then([&result](std::unique_ptr<long> l) { result = l ? *l : -1; });
+
+    assert(!fut0.valid() && !fut1.valid() && !fut2.valid() && (result == -1));
+
+    prm0.set_value(5);
+
+    assert(result == -1);
+
+    prm1.set_value(std::make_unique<int>(3));
+
+    assert(result == 15);
+  }
+  {
+    auto [prm0, fut0] = make_promise<int>();
+    auto [prm1, fut1] = make_promise<std::unique_ptr<int>>();
+
+    future<std::unique_ptr<long>> fut2 = fut0.then([fut = std::move(fut1)](int i) mutable {
+      return fut.then([i](std::unique_ptr<int> pi) { return std::make_unique<long>(i * (pi ? *pi : 0)); });
+    });
+
+    long result = -1;
+    fut2.then([&result](std::unique_ptr<long> l) { result = l ? *l : -1; });
+
+    assert(!fut0.valid() && !fut1.valid() && !fut2.valid() && (result == -1));
+
+    prm1.set_value(std::make_unique<int>(3));
+
+    assert(result == -1);
+
+    prm0.set_value(5);
+
+    assert(result == 15);
+  }
+  {
+    auto [prm0, fut0] = make_promise<std::unique_ptr<long>>();
+    auto [prm1, fut1] = make_promise<std::unique_ptr<int>>();
+
+    future<std::unique_ptr<long>> fut2 =
+      fut0.catch_exception([=, fut = std::move(fut1)](std::exception_ptr ex) mutable {
+        return fut.then([i = exception_to_five(std::move(ex))](std::unique_ptr<int> pi) {
+          return std::make_unique<long>(i * (pi ? *pi : 0));
+        });
+      });
+
+    long result = -1;
+    fut2.then([&result](std::unique_ptr<long> l) { result = l ? *l : -1; });
+
+    assert(!fut0.valid() && !fut1.valid() && !fut2.valid() && (result == -1));
+
+    prm0.set_exception(std::make_exception_ptr(test_exception{}));
+
+    assert(result == -1);
+
+    prm1.set_value(std::make_unique<int>(3));
+
+    assert(result == 15);
+  }
+
+  // Ready future
+  {
+    future<int> fut = make_ready_future(5);
+
+    assert(fut.ready());
+
+    int result = -1;
+    fut.then([&result](int i) { result = i; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    future<long> fut = make_ready_future<long>(5);
+
+    assert(fut.ready());
+
+    long result = -1;
+    fut.then([&result](long l) { result = l; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+  {
+    future<int> fut = make_exceptional_future<int>(std::make_exception_ptr(test_exception{}));
+
+    assert(fut.ready());
+
+    long result = -1;
+    fut.catch_exception(exception_to_five).then([&result](int i) { result = i; });
+
+    assert(!fut.valid() && (result == 5));
+  }
+
+#if defined(YOLO_CACHE_ALIGNED)
+  // Cache aligned states
+  {
+    static_assert(alignof(detail::future_state<int>) == YOLO_CACHE_LINE_SIZE);
+    static_assert(sizeof(detail::future_state<int>) % YOLO_CACHE_LINE_SIZE == 0);
+
+    auto [prm0, fut0] = make_promise<int>();
+    auto [prm1, fut1] = make_promise<int>();
+
+    const auto address0 = reinterpret_cast<std::uintptr_t>(detail::future_helper::state(fut0).get());
+    const auto address1 = reinterpret_cast<std::uintptr_t>(detail::future_helper::state(fut1).get());
+
+    assert((address0 % YOLO_CACHE_LINE_SIZE == 0) && (address1 % YOLO_CACHE_LINE_SIZE == 0));
+
+    int result = 0;
+    fut0.then([&result](int i) { result += i; });
+    fut1.then([&result](int i) { result += i; });
+
+    prm0.set_value(2);
+    prm1.set_value(3);
+
+    assert(result == 5);
+  }
+#endif
+
+#if defined(YOLO_FUTURE_REGISTRY)
+  // Registry of live states
+  const auto pending_here = []() {
+    std::vector<future_info> result;
+
+    for (const future_info& info : oldest_pending_futures(64))
+    {
+      if (info.file && (std::string_view(info.file) == __FILE__))
+        result.push_back(info);
+    }
+
+    return result;
+  };
+
+  {
+    const unsigned line = __LINE__ + 1;
+    auto [prm, fut] = make_promise<int>();
+    future<int> next = fut.then([](int i) { return i + 1; }).then([](int i) { return i + 1; });
+
+    const std::vector<future_info> pending = pending_here();
+
+    assert(pending.size() == 3);
+    assert((pending[0].line == line) && (pending[1].line == line) && (pending[2].line == line));
+    assert((pending[0].depth == 0) && (pending[1].depth == 1) && (pending[2].depth == 2));
+    assert(pending[0].age >= pending[2].age);
+
+    prm.set_value(1);
+
+    assert(pending_here().empty());
+    assert(next.ready());
+  }
+  {
+    async_mutex mutex;
+    channel<int> chan(0);
+
+    std::optional<async_mutex::guard> held = mutex.try_lock();
+
+    const unsigned line = __LINE__ + 1;
+    future<async_mutex::guard> locked = mutex.lock();
+    future<std::optional<int>> received = chan.receive();
+
+    const std::vector<future_info> pending = pending_here();
+
+    assert(pending.size() == 2);
+    assert((pending[0].line == line) && (pending[1].line == line + 1));
+
+    held.reset();
+    chan.close();
+
+    assert(pending_here().empty());
+  }
+#if !defined(YOLO_SINGLE_THREADED)
+  {
+    std::atomic<bool> done{false};
+
+    std::thread dumper([&done]() {
+      while (!done.load())
+        (void)oldest_pending_futures(8);
+    });
+
+    std::vector<promise<int>> pending;
+
+    for (int i = 0; i < 10000; ++i)
+    {
+      auto [prm, fut] = make_promise<int>();
+      fut.then([](int j) { return j + 1; }).then([](int) {});
+
+      pending.push_back(std::move(prm));
+
+      if (pending.size() == 16)
+      {
+        for (promise<int>& p : pending)
+          p.set_value(i);
+
+        pending.clear();
+      }
+    }
+
+    done.store(true);
+    dumper.join();
+  }
+#endif
+#endif
+
+  // Timer wheel
+  {
+    const auto start = timer_wheel::clock::now();
+    timer_wheel wheel(std::chrono::milliseconds(1), start);
+
+    bool result = false;
+    make_delayed_future(wheel, start + std::chrono::milliseconds(10)).then([&result]() { result = true; });
+
+    const std::size_t early = wheel.advance(start + std::chrono::milliseconds(9));
+
+    assert((early == 0) && !result);
+
+    const std::size_t expired = wheel.advance(start + std::chrono::milliseconds(10));
+
+    assert((expired == 1) && result && wheel.empty());
+  }
+  {
+    const auto start = timer_wheel::clock::now();
+    timer_wheel wheel(std::chrono::milliseconds(1), start);
+
+    int result = 0;
+    for (int i : {100000, 5, 70, 4100, 300000})
+      make_delayed_future(wheel, start + std::chrono::milliseconds(i)).then([&result]() { ++result; });
+
+    const std::size_t expired0 = wheel.advance(start + std::chrono::milliseconds(4099));
+
+    assert((expired0 == 2) && (result == 2));
+
+    const std::size_t expired1 = wheel.advance(start + std::chrono::milliseconds(100000));
+
+    assert((expired1 == 2) && (result == 4));
+
+    const std::size_t expired2 = wheel.advance(start + std::chrono::milliseconds(300000));
+
+    assert((expired2 == 1) && (result == 5));
+  }
+  {
+    const auto start = timer_wheel::clock::now();
+    timer_wheel wheel(std::chrono::milliseconds(1), start);
+
+    auto [prm, fut] = make_promise<int>();
+
+    int result = -1;
+    with_timeout(wheel, std::move(fut), start + std::chrono::milliseconds(10)).then([&result](int i) { result = i; });
+
+    assert(!wheel.empty() && (result == -1));
+
+    prm.set_value(5);
+
+    assert(wheel.empty() && (result == 5));
+
+    const std::size_t expired = wheel.advance(start + std::chrono::milliseconds(10));
+
+    assert(expired == 0);
+  }
+  {
+    const auto start = timer_wheel::clock::now();
+    timer_wheel wheel(std::chrono::milliseconds(1), start);
+
+    auto [prm, fut] = make_promise<int>();
+
+    int result = -1;
+    with_timeout(wheel, std::move(fut), start + std::chrono::milliseconds(10))
+      .catch_exception([](std::exception_ptr ex) {
+        try
+        {
+          std::rethrow_exception(std::move(ex));
+        }
+        catch (const timeout_error&)
+        {
+          return 5;
+        }
+        catch (...)
+        {
+          return -1;
+        }
+      })
+      .then([&result](int i) { result = i; });
+
+    const std::size_t expired = wheel.advance(start + std::chrono::milliseconds(10));
+
+    assert((expired == 1) && wheel.empty() && (result == 5));
+
+    prm.set_value(10);
+
+    assert(result == 5);
+  }
+  {
+    auto wheel = std::make_unique<timer_wheel>();
+
+    auto [prm, fut] = make_promise<int>();
+
+    int result = -1;
+    with_timeout(*wheel, std::move(fut), std::chrono::milliseconds(10))
+      .catch_exception([](std::exception_ptr ex) {
+        try
+        {
+          std::rethrow_exception(std::move(ex));
+        }
+        catch (const timeout_error&)
+        {
+          return -1;
+        }
+        catch (const future_error&)
+        {
+          return 5;
+        }
+      })
+      .then([&result](int i) { result = i; });
+
+    wheel.reset();
+
+    assert(result == 5);
+
+    prm.set_value(10);
+
+    assert(result == 5);
+  }
+  {
+    timer_wheel wheel;
+
+    future<int> fut = with_timeout(wheel, make_ready_future(5), std::chrono::milliseconds(10));
+
+    assert(fut.ready() && wheel.empty());
+  }
+
+  // Parallel algorithms
+  {
+    inline_executor executor;
+    std::vector<int> values(1000);
+
+    for (std::size_t i = 0; i < values.size(); ++i)
+      values[i] = static_cast<int>(i);
+
+    long result = -1;
+    transform_reduce(
+      executor, values, 5L, [](int i) { return 2L * i; }, [](long lhs, long rhs) { return lhs + rhs; })
+      .then([&result](long l) { result = l; });
+
+    assert(result == 999005);
+
+    long sum = 0;
+    parallel_for(executor, values, [&sum](int i) { sum += i; }).then([&result]() { result = 0; });
+
+    assert((result == 0) && (sum == 499500));
+  }
+  {
+    struct deferred_executor
+    {
+      std::vector<std::function<void()>> tasks;
+
+      void post(std::function<void()> task)
+      {
+        tasks.push_back(std::move(task));
+      }
+    };
+
+    deferred_executor executor;
+    std::vector<int> values{1, 2, 3, 4, 5, 6, 7};
+
+    parallel_options options;
+    options.tasks = 4;
+
+    long result = -1;
+    transform_reduce(
+      executor,
+      values,
+      0L,
+      [](int i) -> long {
+        if (i == 6)
+          throw test_exception{};
+        return i;
+      },
+      [](long lhs, long rhs) { return lhs + rhs; },
+      options)
+      .catch_exception(exception_to_five)
+      .then([&result](long l) { result = l; });
+
+    assert((executor.tasks.size() == 4) && (result == -1));
+
+    for (auto& task : executor.tasks)
+      task();
+
+    assert(result == 5);
+  }
+  {
+    inline_executor executor;
+    std::vector<int> values;
+
+    int result = -1;
+    transform_reduce(executor, values, 5, [](int i) { return i; }, [](int lhs, int rhs) { return lhs + rhs; })
+      .then([&result](int i) { result = i; });
+
+    assert(result == 5);
+  }
+  {
+    std::vector<int> values{1, 2, 3, 4, 5};
+    std::vector<promise<int>> pending;
+    pending.reserve(values.size());
+
+    std::vector<int> result;
+    bounded_map(values, 2, [&pending](int) {
+      auto [prm, fut] = make_promise<int>();
+      pending.push_back(std::move(prm));
+      return std::move(fut);
+    }).then([&result](std::vector<int> v) { result = std::move(v); });
+
+    assert(pending.size() == 2);
+
+    pending[1].set_value(20);
+
+    assert(pending.size() == 3);
+
+    pending[0].set_value(10);
+    pending[2].set_value(30);
+
+    assert(pending.size() == 5);
+
+    pending[4].set_value(50);
+    pending[3].set_value(40);
+
+    assert(result == (std::vector<int>{10, 20, 30, 40, 50}));
+  }
+  {
+    std::vector<int> values(100000);
+
+    std::size_t result = 0;
+    bounded_map(values, 4, [](int i) { return make_ready_future(i + 1); }).then([&result](std::vector<int> v) {
+      result = v.size();
+    });
+
+    assert(result == 100000);
+  }
+  {
+    std::vector<int> values{1, 2, 3};
+
+    int started = 0;
+    long result = -1;
+    bounded_map(values, 1, [&started](int i) {
+      ++started;
+      if (i == 2)
+        return make_exceptional_future<long>(std::make_exception_ptr(test_exception{}));
+      return make_ready_future(long{i});
+    })
+      .then([](std::vector<long>) { return 0L; })
+      .catch_exception(exception_to_five)
+      .then([&result](long l) { result = l; });
+
+    assert((started == 2) && (result == 5));
+  }
+#if !defined(YOLO_SINGLE_THREADED)
+  {
+    std::vector<int> values(100000, 1);
+
+    auto [prm, fut] = make_promise<long>();
+
+    {
+      thread_pool pool(4);
+
+      parallel_options options;
+      options.chunk_time = std::chrono::microseconds(10);
+
+      transform_reduce(
+        pool, values, 0L, [](int i) { return long{i}; }, [](long lhs, long rhs) { return lhs + rhs; }, options)
+        .then([prm = std::move(prm)](long l) mutable { prm.set_value(l); });
+    }
+
+    long result = -1;
+    fut.then([&result](long l) { result = l; });
+
+    assert(result == 100000);
+  }
+#endif
+
+  // Future array
+  {
+    future_array<double> scores(130);
+
+    for (std::size_t i = 0; i < 130; ++i)
+    {
+      if ((i != 5) && (i != 64))
+        scores.set_value(i, static_cast<double>(i));
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> runs;
+    double sum = 0.0;
+
+    const auto visit = [&runs, &sum](std::size_t first, const double* values, std::size_t count) {
+      runs.emplace_back(first, count);
+
+      for (std::size_t i = 0; i < count; ++i)
+        sum += values[i];
+    };
+
+    const std::size_t visited = scores.then_each(visit);
+
+    assert((visited == 128) && (runs.size() == 3) && (runs[0] == std::make_pair(std::size_t{0}, std::size_t{5})));
+    assert((runs[1] == std::make_pair(std::size_t{6}, std::size_t{58})));
+    assert((runs[2] == std::make_pair(std::size_t{65}, std::size_t{65})));
+
+    const std::size_t revisited = scores.then_each(visit);
+
+    assert(revisited == 0);
+
+    double result = -1.0;
+    scores.reduce(0.0, [](double lhs, double rhs) { return lhs + rhs; }).then([&result](double d) { result = d; });
+
+    assert((scores.pending() == 2) && (result == -1.0));
+
+    scores.set_value(5, 5.0);
+    scores.set_value(64, 64.0);
+
+    const std::size_t remaining = scores.then_each(visit);
+
+    assert((scores.pending() == 0) && (result == 129.0 * 130.0 / 2.0));
+    assert((remaining == 2) && (sum == result));
+  }
+  {
+    auto [prm0, fut0] = make_promise<int>();
+    auto [prm1, fut1] = make_promise<int>();
+
+    std::vector<future<int>> futures;
+    futures.push_back(make_ready_future(1));
+    futures.push_back(std::move(fut0));
+    futures.push_back(std::move(fut1));
+
+    future_array<int> array(std::move(futures));
+
+    int result = -1;
+    array.reduce(0L, [](long lhs, int rhs) { return lhs + rhs; })
+      .then([](long l) { return static_cast<int>(l); })
+      .catch_exception(exception_to_five)
+      .then([&result](int i) { result = i; });
+
+    assert(array.ready(0) && !array.ready(1));
+
+    prm0.set_value(2);
+    prm1.set_exception(std::make_exception_ptr(test_exception{}));
+
+    assert((result == 5) && array.exception(2) && !array.exception(1));
+
+    try
+    {
+      array.set_value(1, 3);
+      assert(false);
+    }
+    catch (const future_error&)
+    {
+    }
+  }
+
+  // Priority lanes
+  {
+    priority_executor executor;
+
+    std::vector<int> order;
+    executor.post(priority::low, [&order]() { order.push_back(2); });
+    executor.post([&order]() { order.push_back(1); });
+    executor.post(priority::high, [&order]() { order.push_back(0); });
+
+    assert(executor.stats(priority::low).depth == 1);
+
+    const std::size_t executed = executor.run();
+
+    assert((executed == 3) && (order == std::vector<int>{0, 1, 2}) && (executor.stats(priority::low).executed == 1));
+  }
+  {
+    priority_executor executor(2);
+
+    std::vector<int> order;
+    executor.post(priority::low, [&order]() { order.push_back(1); });
+
+    for (int i = 0; i < 4; ++i)
+      executor.post(priority::high, [&order]() { order.push_back(0); });
+
+    executor.run();
+
+    assert((order == std::vector<int>{0, 0, 1, 0, 0}) && (executor.stats(priority::high).max_depth == 4));
+  }
+  {
+    priority_executor executor;
+
+    auto [prm0, fut0] = make_promise<int>();
+    auto [prm1, fut1] = make_promise<int>();
+
+    std::vector<int> order;
+    fut0.then(executor, priority::low, [&order](int i) { order.push_back(i); });
+    fut1.then(executor, priority::high, [](int i) { return make_ready_future(2 * i); }).then([&order](int i) {
+      order.push_back(i);
+    });
+
+    prm0.set_value(5);
+    prm1.set_value(5);
+
+    assert(order.empty());
+
+    executor.run();
+
+    assert(order == (std::vector<int>{10, 5}));
+  }
+  {
+    priority_executor executor;
+
+    auto [prm, fut] = make_promise<long>();
+
+    long result = -1;
+    fut.then(executor, priority::normal, [](long l) { return l; })
+      .catch_exception(exception_to_five)
+      .then([&result](long l) { result = l; });
+
+    prm.set_exception(std::make_exception_ptr(test_exception{}));
+
+    assert(result == -1);
+
+    const std::size_t executed = executor.run();
+
+    assert((executed == 1) && (result == 5));
+  }
+
+  // Asynchronous synchronization primitives
+  {
+    async_mutex mutex;
+
+    std::vector<int> order;
+    future<async_mutex::guard> first = mutex.lock();
+
+    assert(first.ready() && !mutex.try_lock());
+
+    for (int i = 0; i < 3; ++i)
+      mutex.lock().then([&order, i](async_mutex::guard) { order.push_back(i); });
+
+    assert(order.empty());
+
+    first.then([](async_mutex::guard) {});
+
+    assert((order == std::vector<int>{0, 1, 2}) && mutex.try_lock());
+  }
+  {
+    async_mutex mutex;
+
+    std::optional<async_mutex::guard> first = mutex.try_lock();
+
+    std::size_t locked = 0;
+    for (int i = 0; i < 100000; ++i)
+      mutex.lock().then([&locked](async_mutex::guard) { ++locked; });
+
+    first.reset();
+
+    assert((locked == 100000) && mutex.try_lock());
+  }
+  {
+    async_semaphore semaphore(3);
+
+    std::optional<async_semaphore::guard> two = semaphore.try_acquire(2);
+
+    assert(two && (semaphore.available() == 1));
+
+    std::optional<async_semaphore::guard> held;
+    semaphore.acquire(2).then([&held](async_semaphore::guard g) { held = std::move(g); });
+
+    bool single = false;
+    semaphore.acquire(1).then([&single](async_semaphore::guard) { single = true; });
+
+    assert(!held && !single && (semaphore.available() == 1));
+
+    two.reset();
+
+    assert(held && single && (semaphore.available() == 1));
+
+    held.reset();
+
+    assert(semaphore.available() == 3);
+  }
+  {
+    auto semaphore = std::make_unique<async_semaphore>(0);
+
+    int result = -1;
+    semaphore->acquire()
+      .then([](async_semaphore::guard) { return 0; })
+      .catch_exception([](std::exception_ptr) { return 5; })
+      .then([&result](int i) { result = i; });
+
+    semaphore.reset();
+
+    assert(result == 5);
+  }
+  {
+    async_latch latch(2);
+
+    int result = 0;
+    latch.wait().then([&result]() { ++result; });
+    latch.wait().then([&result]() { ++result; });
+
+    latch.count_down();
+
+    assert((result == 0) && !latch.try_wait());
+
+    latch.count_down();
+
+    assert((result == 2) && latch.try_wait() && latch.wait().ready());
+  }
+
+  // Asynchronous cache
+  {
+    async_cache<int, long> cache(4, 2);
+
+    int loads = 0;
+    std::vector<promise<long>> pending;
+
+    const auto load = [&loads, &pending](int) {
+      ++loads;
+      auto [prm, fut] = make_promise<long>();
+      pending.push_back(std::move(prm));
+      return std::move(fut);
+    };
+
+    long result0 = -1;
+    long result1 = -1;
+    cache.get(1, load).then([&result0](long l) { result0 = l; });
+    cache.get(1, load).then([&result1](long l) { result1 = l; });
+
+    const std::optional<long> loading = cache.try_get(1);
+
+    assert((loads == 1) && (result0 == -1) && (result1 == -1) && !loading);
+
+    pending.front().set_value(5);
+
+    const std::optional<long> loaded = cache.try_get(1);
+
+    assert((result0 == 5) && (result1 == 5) && (loaded == 5L));
+
+    future<long> hit = cache.get(1, load);
+
+    assert(hit.ready() && (loads == 1));
+
+    cache.erase(1);
+
+    const std::optional<long> erased = cache.try_get(1);
+
+    assert(!erased && (cache.size() == 0));
+  }
+  {
+    async_cache<int, long> cache(4, 1);
+
+    int loads = 0;
+    const auto load = [&loads](int i) {
+      ++loads;
+      return make_ready_future(long{i});
+    };
+
+    for (int i = 0; i < 4; ++i)
+      cache.get(i, load).then([](long) {});
+
+    assert((cache.size() == 4) && (loads == 4));
+
+    // Referenced entries survive a sweep of the clock hand
+    const std::optional<long> referenced0 = cache.try_get(0);
+    const std::optional<long> referenced1 = cache.try_get(1);
+
+    assert(referenced0 && referenced1);
+
+    cache.get(4, load).then([](long) {});
+
+    const std::optional<long> kept0 = cache.try_get(0);
+    const std::optional<long> kept1 = cache.try_get(1);
+    const std::optional<long> evicted = cache.try_get(2);
+    const std::optional<long> inserted = cache.try_get(4);
+
+    assert((cache.size() == 4) && kept0 && kept1 && !evicted && inserted);
+  }
+  {
+    async_cache<int, long> cache(4);
+
+    for (int i = 0; i < 100; ++i)
+      cache.get(i, [](int j) { return make_ready_future(long{j}); }).then([](long) {});
+
+    assert(cache.size() == 4);
+  }
+  {
+    async_cache<int, long> cache(4);
+
+    const auto load = [](int) -> future<long> { throw test_exception{}; };
+
+    long result = -1;
+    cache.get(1, load).catch_exception(exception_to_five).then([&result](long l) { result = l; });
+
+    assert((result == 5) && (cache.size() == 0));
+  }
+
+  // Channel
+  {
+    channel<int> chan(2);
+
+    const bool sent1 = chan.send(1).ready();
+    const bool sent2 = chan.try_send(2);
+    const bool sent3 = chan.try_send(3);
+
+    assert(sent1 && sent2 && !sent3);
+
+    bool sent = false;
+    chan.send(3).then([&sent]() { sent = true; });
+
+    assert(!sent && (chan.size() == 2));
+
+    const std::optional<int> first = chan.try_receive();
+
+    assert((first == 1) && sent && (chan.size() == 2));
+
+    std::vector<int> received;
+    for (int i = 0; i < 3; ++i)
+      chan.receive().then([&received](std::optional<int> value) { received.push_back(value ? *value : -1); });
+
+    assert((received == std::vector<int>{2, 3}) && (chan.size() == 0));
+
+    const bool sent4 = chan.try_send(4);
+
+    assert(sent4 && (received == std::vector<int>{2, 3, 4}) && (chan.size() == 0));
+
+    chan.receive().then([&received](std::optional<int> value) { received.push_back(value ? *value : -1); });
+    chan.close();
+
+    const bool sent5 = chan.try_send(5);
+
+    assert((received == std::vector<int>{2, 3, 4, -1}) && !sent5);
+
+    int result = -1;
+    chan.send(5).then([]() { return 0; }).catch_exception([](std::exception_ptr) { return 5; }).then([&result](int i) {
+      result = i;
+    });
+
+    assert(result == 5);
+  }
+  {
+    channel<std::unique_ptr<int>> chan(0);
+
+    int result = -1;
+    chan.send(std::make_unique<int>(5)).then([&result]() { result = 0; });
+
+    assert(result == -1);
+
+    chan.receive().then([&result](std::optional<std::unique_ptr<int>> value) { result += **value; });
+
+    assert(result == 5);
+  }
+
+  // I/O reactor
+#if defined(__linux__)
+  {
+    io_context context;
+
+    int fds[2];
+    const int piped = ::pipe(fds);
+
+    assert(piped == 0);
+
+    char buffer[8] = {};
+    std::size_t result = 0;
+    context.async_read(fds[0], buffer, sizeof(buffer)).then([&result](std::size_t n) { result = n; });
+
+    const std::size_t polled = context.poll();
+
+    assert((context.pending() == 1) && (polled == 0));
+
+    bool written = false;
+    context.async_write(fds[1], "yolo", 4).then([&written](std::size_t n) { written = (n == 4); });
+
+    assert(written && (result == 0));
+
+    const std::size_t completed = context.run();
+
+    assert((completed == 1) && (result == 4) && (std::string_view(buffer, 4) == "yolo"));
+
+    context.cancel(fds[0]);
+    context.cancel(fds[1]);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+  {
+    io_context context;
+
+    int fds[2];
+    const int piped = ::pipe(fds);
+
+    assert(piped == 0);
+
+    char buffer[8] = {};
+    std::size_t nested = 1;
+    context.async_read(fds[0], buffer, sizeof(buffer)).then([&context, &nested](std::size_t) {
+      nested = context.poll();
+    });
+
+    const long written = ::write(fds[1], "yolo", 4);
+    const std::size_t completed = context.run_once();
+
+    assert((written == 4) && (completed == 1) && (nested == 0) && (context.pending() == 0));
+
+    context.cancel(fds[0]);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+  }
+  {
+    io_context context;
+
+    int fds[2];
+    const int paired = ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    assert(paired == 0);
+
+    char buffer[8] = {};
+    long result = -1;
+    context.async_read(fds[0], buffer, sizeof(buffer))
+      .then([](std::size_t) { return 0L; })
+      .catch_exception([](std::exception_ptr ex) {
+        try
+        {
+          std::rethrow_exception(std::move(ex));
+        }
+        catch (const std::system_error& e)
+        {
+          return (e.code().value() == ECANCELED) ? 5L : -1L;
+        }
+      })
+      .then([&result](long l) { result = l; });
+
+    context.cancel(fds[0]);
+
+    assert((context.pending() == 0) && (result == 5));
+
+    ::close(fds[1]);
+
+    std::size_t eof = 1;
+    context.async_read(fds[0], buffer, sizeof(buffer)).then([&eof](std::size_t n) { eof = n; });
+
+    assert(eof == 0);
+
+    context.cancel(fds[0]);
+    ::close(fds[0]);
+  }
+  {
+    io_context context;
+
+    const int server = ::socket(AF_INET, SOCK_STREAM, 0);
+    assert(server >= 0);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+
+    const int bound = ::bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    const int listening = ::listen(server, 1);
+    const int named = ::getsockname(server, reinterpret_cast<sockaddr*>(&address), &length);
+
+    assert((bound == 0) && (listening == 0) && (named == 0));
+
+    int accepted = -1;
+    context.async_accept(server).then([&accepted](int fd) { accepted = fd; });
+
+    assert(accepted == -1);
+
+    const int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    const int connected = ::connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+
+    assert((client >= 0) && (connected == 0));
+
+    context.run();
+
+    assert(accepted >= 0);
+
+    char buffer[8] = {};
+    std::size_t result = 0;
+    context.async_read(accepted, buffer, sizeof(buffer)).then([&result](std::size_t n) { result = n; });
+
+    const long written = ::write(client, "yolo", 4);
+
+    assert(written == 4);
+
+    context.run();
+
+    assert((result == 4) && (std::string_view(buffer, 4) == "yolo"));
+
+    context.cancel(accepted);
+    context.cancel(server);
+
+    ::close(accepted);
+    ::close(client);
+    ::close(server);
+  }
+
+  // Cross process promises
+  {
+    struct sample
+    {
+      int id;
+      double score;
+    };
+
+    shm_segment segment;
+
+    auto [prm, fut] = segment.make_promise<sample>();
+
+    assert(fut.valid() && !fut.ready() && !fut.wait_for(std::chrono::milliseconds(1)));
+
+    const pid_t child = ::fork();
+
+    if (child == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      prm.set_value(sample{5, 0.5});
+      ::_exit(0);
+    }
+
+    const sample result = fut.get();
+
+    assert(fut.ready() && (result.id == 5) && (result.score == 0.5));
+
+    int status = -1;
+    const pid_t reaped = ::waitpid(child, &status, 0);
+
+    assert((reaped == child) && WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+  }
+  {
+    shm_segment segment;
+
+    auto [prm, fut] = segment.make_promise<int>();
+
+    prm.set_error(ECANCELED);
+
+    int result = -1;
+    try
+    {
+      result = fut.get();
+    }
+    catch (const std::system_error& e)
+    {
+      result = (e.code().value() == ECANCELED) ? 5 : -1;
+    }
+
+    assert(result == 5);
+
+    try
+    {
+      prm.set_value(10);
+      result = -1;
+    }
+    catch (const future_error&)
+    {
+    }
+
+    assert(result == 5);
+  }
+  {
+    shm_segment segment(4096);
+
+    // Recycled slots, older handles of a slot don't affect the current promise
+    for (int i = 0; i < 1000; ++i)
+    {
+      auto [prm, fut] = segment.make_promise<int>();
+
+      prm.set_value(i);
+
+      const int result = fut.get();
+
+      assert(result == i);
+    }
+
+    auto [prm0, fut0] = segment.make_promise<int>();
+    const shm_handle handle0 = prm0.handle();
+
+    fut0 = shm_future<int>();
+
+    auto [prm1, fut1] = segment.make_promise<int>();
+    const shm_handle handle1 = prm1.handle();
+
+    prm0.set_value(5);
+
+    assert((handle0.offset == handle1.offset) && (handle0.generation != handle1.generation) && !fut1.ready());
+
+    prm1.set_value(10);
+
+    const int result = fut1.get();
+
+    assert(result == 10);
+  }
+  {
+    shm_segment segment;
+
+    int requests[2];
+    int results[2];
+    const int piped0 = ::pipe(requests);
+    const int piped1 = ::pipe(results);
+
+    assert((piped0 == 0) && (piped1 == 0));
+
+    const pid_t worker = ::fork();
+
+    if (worker == 0)
+    {
+      // Satisfies the promises the parent makes after the fork, then sends a result of its own
+      shm_handle handle;
+
+      for (int i = 0; i < 2; ++i)
+      {
+        if (::read(requests[0], &handle, sizeof(handle)) != sizeof(handle))
+          ::_exit(1);
+
+        segment.attach_promise<int>(handle).set_value(i + 5);
+      }
+
+      auto [prm, fut] = segment.make_promise<int>();
+      prm.set_value(7);
+
+      handle = fut.detach();
+
+      if (::write(results[1], &handle, sizeof(handle)) != sizeof(handle))
+        ::_exit(1);
+
+      ::_exit(0);
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+      auto [prm, fut] = segment.make_promise<int>();
+
+      const shm_handle handle = prm.handle();
+      const long sent = ::write(requests[1], &handle, sizeof(handle));
+      const int result = fut.get();
+
+      assert((sent == sizeof(handle)) && (result == i + 5));
+    }
+
+    shm_handle handle;
+    const long received = ::read(results[0], &handle, sizeof(handle));
+
+    assert(received == sizeof(handle));
+
+    const int result = segment.attach_future<int>(handle).get();
+
+    int status = -1;
+    const pid_t reaped = ::waitpid(worker, &status, 0);
+
+    assert((result == 7) && (reaped == worker) && WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+
+    for (int fd : {requests[0], requests[1], results[0], results[1]})
+      ::close(fd);
+  }
+#endif
+
+  return 0;
+}
+
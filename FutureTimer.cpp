@@ -0,0 +1,244 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "FutureTimer.h"
+
+namespace yolo
+{
+  timer_wheel::timer_wheel(clock::duration resolution, clock::time_point start)
+    : _resolution(resolution)
+    , _start(start)
+  {
+    assert(resolution > clock::duration::zero());
+
+    for (detail::timer_link& slot : _slots)
+      slot._prev = slot._next = &slot;
+  }
+
+  timer_wheel::~timer_wheel()
+  {
+    // Abandoned timers may run continuations which arm new timers, those are abandoned as well
+    for (bool abandoned = true; abandoned;)
+    {
+      abandoned = false;
+
+      for (detail::timer_link& slot : _slots)
+      {
+        while (slot._next != &slot)
+        {
+          auto& node = static_cast<detail::timer_node&>(*slot._next);
+
+          unlink(node);
+
+          --_size;
+
+          const std::shared_ptr<detail::timer_node> self = std::move(node._self);
+
+          self->abandon();
+
+          abandoned = true;
+        }
+      }
+    }
+  }
+
+  std::size_t timer_wheel::size() const
+  {
+#if !defined(YOLO_SINGLE_THREADED)
+    const std::lock_guard lock(_mutex);
+#endif
+
+    return _size;
+  }
+
+  void timer_wheel::schedule(std::shared_ptr<detail::timer_node> node, clock::time_point deadline)
+  {
+    assert(node && !node->_self);
+
+    detail::timer_node& ref = *node;
+
+#if !defined(YOLO_SINGLE_THREADED)
+    const std::lock_guard lock(_mutex);
+#endif
+
+    ref._expiry = ticks_until(deadline);
+    ref._self = std::move(node);
+
+    link(ref);
+
+    ++_size;
+  }
+
+  void timer_wheel::cancel(detail::timer_node& node) noexcept
+  {
+    std::shared_ptr<detail::timer_node> self;
+
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      if (!node._next)
+        return;
+
+      unlink(node);
+
+      self = std::move(node._self);
+
+      --_size;
+    }
+  }
+
+  std::size_t timer_wheel::advance(clock::time_point now)
+  {
+    detail::timer_node* expired = nullptr;
+
+    {
+#if !defined(YOLO_SINGLE_THREADED)
+      const std::lock_guard lock(_mutex);
+#endif
+
+      if (now < _start)
+        return 0;
+
+      const auto target = static_cast<std::uint64_t>((now - _start) / _resolution);
+      detail::timer_node** tail = &expired;
+
+      for (; _tick <= target; ++_tick)
+      {
+        if (_size == 0)
+        {
+          _tick = target + 1;
+          break;
+        }
+
+        if ((_tick & slot_mask) == 0)
+        {
+          for (std::size_t level = 1; level < level_count; ++level)
+          {
+            const std::size_t index = (_tick >> (level * slot_bits)) & slot_mask;
+
+            cascade(level * slot_count + index);
+
+            if (index != 0)
+              break;
+          }
+        }
+
+        detail::timer_link& slot = _slots[_tick & slot_mask];
+
+        while (slot._next != &slot)
+        {
+          auto& node = static_cast<detail::timer_node&>(*slot._next);
+
+          unlink(node);
+
+          *tail = &node;
+          tail = &node._expired;
+
+          --_size;
+        }
+      }
+    }
+
+    std::size_t count = 0;
+
+    while (expired)
+    {
+      const std::shared_ptr<detail::timer_node> self = std::move(expired->_self);
+
+      expired = std::exchange(expired->_expired, nullptr);
+
+      self->expire();
+
+      ++count;
+    }
+
+    return count;
+  }
+
+  std::uint64_t timer_wheel::ticks_until(clock::time_point deadline) const noexcept
+  {
+    if (deadline <= _start)
+      return 0;
+
+    return static_cast<std::uint64_t>((deadline - _start + _resolution - clock::duration{1}) / _resolution);
+  }
+
+  void timer_wheel::link(detail::timer_node& node) noexcept
+  {
+    const std::uint64_t delta = (node._expiry > _tick) ? (node._expiry - _tick) : 0;
+
+    // Timers beyond the range of the top level are parked there and relinked when cascaded
+    const std::uint64_t expiry = (delta > max_ticks) ? (_tick + max_ticks) : (_tick + delta);
+
+    std::size_t level = 0;
+
+    while ((level + 1 < level_count) && (delta >> ((level + 1) * slot_bits)) != 0)
+      ++level;
+
+    detail::timer_link& slot = _slots[level * slot_count + ((expiry >> (level * slot_bits)) & slot_mask)];
+
+    node._prev = slot._prev;
+    node._next = &slot;
+    slot._prev->_next = &node;
+    slot._prev = &node;
+  }
+
+  void timer_wheel::unlink(detail::timer_link& node) noexcept
+  {
+    node._prev->_next = node._next;
+    node._next->_prev = node._prev;
+    node._prev = node._next = nullptr;
+  }
+
+  void timer_wheel::cascade(std::size_t index) noexcept
+  {
+    detail::timer_link& slot = _slots[index];
+
+    while (slot._next != &slot)
+    {
+      auto& node = static_cast<detail::timer_node&>(*slot._next);
+
+      unlink(node);
+      link(node);
+    }
+  }
+
+  future<void> make_delayed_future(timer_wheel& wheel, timer_wheel::clock::time_point deadline)
+  {
+    auto delay = std::make_shared<detail::future_delay>();
+    auto [prm, fut] = make_promise<void>();
+
+    delay->_promise = std::move(prm);
+
+    wheel.schedule(std::move(delay), deadline);
+
+    return std::move(fut);
+  }
+
+  future<void> make_delayed_future(timer_wheel& wheel, timer_wheel::clock::duration delay)
+  {
+    return make_delayed_future(wheel, timer_wheel::clock::now() + delay);
+  }
+
+} // namespace yolo
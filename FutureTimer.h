@@ -0,0 +1,281 @@
+/*
+Copyright (c) 2019 Daniel Eiband
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef YOLO_FUTURE_TIMER_H
+#define YOLO_FUTURE_TIMER_H
+
+#include "Future.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace yolo
+{
+  class timeout_error : public future_error
+  {
+  public:
+    timeout_error()
+      : future_error("timeout")
+    {
+    }
+  };
+
+  class timer_wheel;
+
+  namespace detail
+  {
+    struct timer_link
+    {
+      timer_link* _prev = nullptr;
+      timer_link* _next = nullptr;
+    };
+
+    struct timer_node : timer_link
+    {
+      timer_node() = default;
+      virtual ~timer_node() = default;
+
+      timer_node(const timer_node& that) = delete;
+      timer_node& operator=(const timer_node& that) = delete;
+
+      virtual void expire() = 0;
+
+      /*
+       * Called instead of expire() if the wheel is destroyed first
+       */
+      virtual void abandon()
+      {
+      }
+
+    private:
+      friend timer_wheel;
+
+      std::uint64_t _expiry = 0;
+      timer_node* _expired = nullptr;
+      std::shared_ptr<timer_node> _self;
+    };
+
+  } // namespace detail
+
+  /*
+   * Hierarchical timer wheel driven by an event loop calling poll() or advance()
+   *
+   * Arming and cancelling a timer is O(1). Timers are grouped into levels of 64 slots each, timers of
+   * the upper levels are cascaded down when the lower level wraps around. Expired timers fire outside of
+   * the internal lock, so a timer may arm or cancel other timers. Destroying the wheel abandons all pending
+   * timers, it must not race with timers being armed or cancelled by other threads.
+   */
+  class timer_wheel
+  {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit timer_wheel(
+      clock::duration resolution = std::chrono::milliseconds(1),
+      clock::time_point start = clock::now());
+
+    timer_wheel(const timer_wheel& that) = delete;
+    timer_wheel& operator=(const timer_wheel& that) = delete;
+
+    ~timer_wheel();
+
+    [[nodiscard]] std::size_t size() const;
+
+    [[nodiscard]] bool empty() const
+    {
+      return (size() == 0);
+    }
+
+    void schedule(std::shared_ptr<detail::timer_node> node, clock::time_point deadline);
+
+    void cancel(detail::timer_node& node) noexcept;
+
+    /*
+     * Fires all timers with a deadline up to now and returns their number
+     */
+    std::size_t advance(clock::time_point now);
+
+    std::size_t poll()
+    {
+      return advance(clock::now());
+    }
+
+  private:
+    static constexpr std::size_t slot_bits = 6;
+    static constexpr std::size_t slot_count = std::size_t{1} << slot_bits;
+    static constexpr std::uint64_t slot_mask = slot_count - 1;
+    static constexpr std::size_t level_count = 5;
+    static constexpr std::uint64_t max_ticks = (std::uint64_t{1} << (slot_bits * level_count)) - 1;
+
+#if !defined(YOLO_SINGLE_THREADED)
+    mutable std::mutex _mutex;
+#endif
+
+    clock::duration _resolution;
+    clock::time_point _start;
+    std::uint64_t _tick = 0;
+    std::size_t _size = 0;
+    std::array<detail::timer_link, slot_count * level_count> _slots;
+
+    [[nodiscard]] std::uint64_t ticks_until(clock::time_point deadline) const noexcept;
+
+    void link(detail::timer_node& node) noexcept;
+
+    static void unlink(detail::timer_link& node) noexcept;
+
+    void cascade(std::size_t index) noexcept;
+  };
+
+  namespace detail
+  {
+    struct future_delay : timer_node
+    {
+      void expire() override
+      {
+        _promise.set_value();
+      }
+
+      promise<void> _promise;
+    };
+
+    template <typename T>
+    struct future_timeout : timer_node
+    {
+      future_timeout(timer_wheel& wheel, std::shared_ptr<future_state<T>> dest)
+        : timer_node{}
+        , _wheel(wheel)
+        , _dest(std::move(dest))
+      {
+      }
+
+      void expire() override
+      {
+        fail(std::make_exception_ptr(timeout_error{}));
+      }
+
+      /*
+       * Claiming the flag keeps the attached source from cancelling the timer on the destroyed wheel
+       */
+      void abandon() override
+      {
+        fail(make_future_error("broken promise"));
+      }
+
+      void fail(std::exception_ptr ex)
+      {
+        if (!_flag.claim())
+          return;
+
+        std::shared_ptr<future_state<T>> dest = std::move(_dest);
+
+        dest->set_value(std::move(ex));
+
+        future_next_ptr next = dest->next();
+
+        execute_future({std::move(next), std::move(dest)});
+      }
+
+      timer_wheel& _wheel;
+      future_flag _flag;
+      std::shared_ptr<future_state<T>> _dest;
+    };
+
+    template <typename T>
+    struct future_timeout_attach : future_continuation
+    {
+      explicit future_timeout_attach(std::shared_ptr<future_timeout<T>> timeout)
+        : future_continuation{}
+        , _timeout(std::move(timeout))
+      {
+      }
+
+      [[nodiscard]] future_next continue_with(future_state_base& state) override
+      {
+        const std::shared_ptr<future_timeout<T>> timeout = std::move(_timeout);
+
+        if (!timeout->_flag.claim())
+          return {};
+
+        timeout->_wheel.cancel(*timeout);
+
+        std::shared_ptr<future_state<T>> dest = std::move(timeout->_dest);
+
+        dest->set_value(static_cast<future_state<T>&>(state).move_value());
+
+        future_next_ptr next = dest->next();
+
+        return {std::move(next), std::move(dest)};
+      }
+
+    private:
+      std::shared_ptr<future_timeout<T>> _timeout;
+    };
+
+  } // namespace detail
+
+  [[nodiscard]] future<void> make_delayed_future(timer_wheel& wheel, timer_wheel::clock::time_point deadline);
+
+  [[nodiscard]] future<void> make_delayed_future(timer_wheel& wheel, timer_wheel::clock::duration delay);
+
+  /*
+   * Fails with timeout_error unless fut is satisfied before the deadline. If the wheel is destroyed first the
+   * future fails with a broken promise. With synchronization, fut must not be satisfied concurrently with the
+   * destruction of the wheel, since satisfying it cancels the timer on the wheel.
+   */
+  template <typename T>
+  [[nodiscard]] future<T> with_timeout(timer_wheel& wheel, future<T> fut, timer_wheel::clock::time_point deadline)
+  {
+    std::shared_ptr<detail::future_state<T>>& src = detail::future_helper::state(fut);
+
+    if (!src)
+      detail::throw_future_error("invalid future");
+
+    if (src->ready())
+      return fut;
+
+    future<T> result;
+    std::shared_ptr<detail::future_state<T>>& dest = detail::future_helper::state(result);
+
+    dest = std::make_shared<detail::future_state<T>>(src->successor());
+
+    auto timeout = std::make_shared<detail::future_timeout<T>>(wheel, dest);
+
+    wheel.schedule(timeout, deadline);
+
+    detail::future_next_ptr next = src->chain(std::make_unique<detail::future_timeout_attach<T>>(std::move(timeout)));
+
+    detail::execute_future({std::move(next), std::move(src)});
+
+    return result;
+  }
+
+  template <typename T>
+  [[nodiscard]] future<T> with_timeout(timer_wheel& wheel, future<T> fut, timer_wheel::clock::duration timeout)
+  {
+    return with_timeout(wheel, std::move(fut), timer_wheel::clock::now() + timeout);
+  }
+
+} // namespace yolo
+
+#endif